@@ -0,0 +1,299 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "batch.hh"
+#include "lockin.hh"
+#include "measurelog.hh"
+#include "replay.hh"
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTextStream>
+#include <QThread>
+#include <QRunnable>
+#include <cmath>
+
+// one file, auto deleted by the pool
+class BatchTask : public QRunnable
+{
+public:
+    BatchTask(BatchAnalysis *batch, int index, const QString &path)
+        : _batch(batch), _index(index), _path(path) {}
+
+    void run() override
+    {
+        _batch->runTask(_index, _path);
+    }
+
+private:
+    BatchAnalysis *_batch;
+    int _index;
+    QString _path;
+};
+
+BatchAnalysis::BatchAnalysis(QObject *parent) : QObject(parent)
+{
+    _settings.integrationTime = 1.0;
+    _settings.outputPeriod = 0.5;
+    _settings.invertLR = false;
+    _cancel = false;
+    _done = 0;
+    _total = 0;
+    _pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+BatchAnalysis::~BatchAnalysis()
+{
+    cancel();
+    _pool.waitForDone();
+}
+
+QStringList BatchAnalysis::recordings(const QString &dir, bool recursive)
+{
+    QStringList paths;
+    QDirIterator it(dir, QStringList() << "*.wav" << "*.lkf", QDir::Files,
+                    recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    while (it.hasNext())
+        paths << it.next();
+    paths.sort();
+    return paths;
+}
+
+void BatchAnalysis::setSettings(const BatchSettings &settings)
+{
+    _settings = settings;
+}
+
+void BatchAnalysis::setMaxThreads(int threads)
+{
+    _pool.setMaxThreadCount(qMax(1, threads));
+}
+
+void BatchAnalysis::start(const QStringList &paths)
+{
+    if (isRunning()) {
+        qDebug() << __FUNCTION__ << ": already running";
+        return;
+    }
+
+    _cancel = false;
+    _done = 0;
+    _total = paths.size();
+    _results.clear();
+    _results.resize(paths.size());
+
+    if (paths.isEmpty()) {
+        emit finished();
+        return;
+    }
+
+    // two tasks writing the same logs would truncate each other
+    QHash<QString, int> bases;
+    QList<int> tasks;
+    for (int i = 0; i < paths.size(); ++i) {
+        const QString base = logBase(paths[i]);
+        if (bases.contains(base)) {
+            qDebug() << __FUNCTION__ << ":" << paths[i] << "has the same logs as" << paths[bases[base]];
+            BatchResult &r = _results[i];
+            r.path = paths[i];
+            r.ok = false;
+            r.error = "same log as " + paths[bases[base]];
+            r.duration = r.referenceFrequency = r.elapsed = 0.0;
+            r.outputs = r.flagged = 0;
+            r.meanX = r.meanY = r.meanR = r.stdR = NAN;
+            ++_done;
+        } else {
+            bases[base] = i;
+            tasks << i;
+        }
+    }
+
+    if (tasks.isEmpty()) {
+        emit finished();
+        return;
+    }
+    foreach (int i, tasks)
+        _pool.start(new BatchTask(this, i, paths[i]));
+}
+
+QString BatchAnalysis::logBase(const QString &path) const
+{
+    const QFileInfo info(path);
+    return (_settings.outputDir.isEmpty() ? info.absolutePath() : QDir(_settings.outputDir).absolutePath())
+            + "/" + info.completeBaseName();
+}
+
+void BatchAnalysis::runTask(int index, const QString &path)
+{
+    BatchResult r = analyse(path);
+    {
+        QMutexLocker lock(&_mutex);
+        _results[index] = r;
+    }
+
+    const int done = ++_done;
+    emit fileDone(index, done, _total);
+    if (done == _total)
+        emit finished();
+}
+
+void BatchAnalysis::cancel()
+{
+    _cancel = true;
+}
+
+bool BatchAnalysis::waitForDone(int msecs)
+{
+    return _pool.waitForDone(msecs);
+}
+
+bool BatchAnalysis::isRunning() const
+{
+    return _done < _total;
+}
+
+QVector<BatchResult> BatchAnalysis::results() const
+{
+    QMutexLocker lock(&_mutex);
+    return _results;
+}
+
+// runs in a thread of the pool
+BatchResult BatchAnalysis::analyse(const QString &path) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    BatchResult r;
+    r.path = path;
+    r.ok = false;
+    r.duration = 0.0;
+    r.referenceFrequency = 0.0;
+    r.outputs = 0;
+    r.flagged = 0;
+    r.meanX = r.meanY = r.meanR = r.stdR = NAN;
+    r.elapsed = 0.0;
+
+    auto progress = [this](qreal) { return !_cancel; };
+
+    Replay replay;
+    if (!replay.open(path, _settings.invertLR, progress)) {
+        r.error = _cancel ? "canceled" : "cannot read";
+        r.elapsed = qreal(timer.nsecsElapsed()) * 1e-9;
+        return r;
+    }
+    const int rate = replay.format().sampleRate();
+    r.referenceFrequency = replay.index().meanFrequency();
+
+    const QString base = logBase(path);
+    r.logPath = base + ".lklog";
+
+    QVector<qreal> times;
+    times << _settings.integrationTime << _settings.extraIntegrationTimes;
+    QVector<MeasureLogWriter *> logs;
+    for (int c = 0; c < times.size(); ++c) {
+        MeasureLogWriter *log = new MeasureLogWriter;
+        const QString logPath = c == 0 ? r.logPath : QString("%1.ch%2.lklog").arg(base).arg(c);
+        if (!log->open(logPath, rate, times[c], _settings.outputPeriod)) {
+            delete log;
+            qDeleteAll(logs);
+            r.error = "cannot write " + logPath;
+            r.elapsed = qreal(timer.nsecsElapsed()) * 1e-9;
+            return r;
+        }
+        logs << log;
+    }
+
+    // only the integration window is kept, not the 5 minutes of the live history
+    Lockin lockin;
+    lockin.setHistoryLength(0.0);
+    lockin.setIntegrationTime(_settings.integrationTime);
+    lockin.setExtraIntegrationTimes(_settings.extraIntegrationTimes);
+
+    qreal sumX = 0.0, sumY = 0.0, sumR = 0.0, sumR2 = 0.0;
+    QObject::connect(&lockin, &Lockin::newMeasure, [&](const LockinMeasure &m) {
+        if (m.channel < logs.size())
+            logs[m.channel]->append(m);
+        if (m.channel != 0)
+            return;
+        const qreal x = m.value.real(), y = m.value.imag(), a = std::abs(m.value);
+        sumX += x;
+        sumY += y;
+        sumR += a;
+        sumR2 += a * a;
+        r.outputs++;
+        if (m.flags != 0)
+            r.flagged++;
+    });
+
+    r.ok = replay.run(&lockin, _settings.outputPeriod, 0, -1, progress) && !_cancel;
+    if (!r.ok)
+        r.error = _cancel ? "canceled" : replay.index().periods() == 0 ? "no reference" : "read error";
+
+    foreach (MeasureLogWriter *log, logs) {
+        log->setReferenceFrequency(r.referenceFrequency);
+        log->close();
+        if (log->hasError() && r.ok) {
+            r.ok = false;
+            r.error = "log write error";
+        }
+    }
+    qDeleteAll(logs);
+
+    if (replay.index().periods() > 0)
+        r.duration = (replay.index().edges().last() - replay.index().edges().first()) / rate;
+    if (r.outputs > 0) {
+        const qreal n = qreal(r.outputs);
+        r.meanX = sumX / n;
+        r.meanY = sumY / n;
+        r.meanR = sumR / n;
+        r.stdR = std::sqrt(qMax(0.0, sumR2 / n - r.meanR * r.meanR));
+    }
+    r.elapsed = qreal(timer.nsecsElapsed()) * 1e-9;
+    return r;
+}
+
+bool BatchAnalysis::writeSummary(const QString &path, const QVector<BatchResult> &results)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qDebug() << __FUNCTION__ << ": cannot write" << path;
+        return false;
+    }
+
+    QTextStream out(&file);
+    out.setRealNumberPrecision(10);
+    out << "file\tstatus\tduration_s\treference_hz\toutputs\tflagged\tmean_x\tmean_y\tmean_r\tstd_r\telapsed_s\tlog\n";
+    foreach (const BatchResult &r, results) {
+        out << r.path << '\t' << (r.ok ? QString("ok") : r.error) << '\t'
+            << r.duration << '\t' << r.referenceFrequency << '\t' << r.outputs << '\t' << r.flagged << '\t'
+            << r.meanX << '\t' << r.meanY << '\t' << r.meanR << '\t' << r.stdR << '\t'
+            << r.elapsed << '\t' << r.logPath << '\n';
+    }
+    return true;
+}
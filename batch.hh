@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+
+/* Offline analysis of many recordings with the same settings
+ *
+ * One file per task of a QThreadPool, each task owns its Replay and its Lockin :
+ * the files are read by blocks of one output period and the integrator only keeps
+ * twice the longest integration time, so the memory of a worker does not grow with the file
+ * (except the reference index, 8 bytes per chopper period).
+ * The outputs go into a measure log per file and channel, the summary into a table.
+ */
+
+struct BatchSettings {
+    qreal integrationTime; // [s] channel 0
+    QVector<qreal> extraIntegrationTimes; // channels 1, 2, ...
+    qreal outputPeriod; // [s]
+    bool invertLR;
+    QString outputDir; // logs next to the recordings if empty, the recordings must then have distinct base names
+};
+
+struct BatchResult {
+    QString path;
+    QString logPath; // channel 0, the other channels end with .ch<N>.lklog
+    bool ok;
+    QString error;
+    qreal duration; // [s] of recording
+    qreal referenceFrequency; // [Hz]
+    qint64 outputs; // channel 0
+    qint64 flagged; // outputs of channel 0 with flags
+    qreal meanX;
+    qreal meanY;
+    qreal meanR;
+    qreal stdR;
+    qreal elapsed; // [s] of analysis
+};
+
+class BatchAnalysis : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BatchAnalysis(QObject *parent = 0);
+    ~BatchAnalysis();
+
+    // the .wav and .lkf files of a directory, sorted by name
+    static QStringList recordings(const QString &dir, bool recursive = false);
+
+    void setSettings(const BatchSettings &settings);
+    void setMaxThreads(int threads); // default QThread::idealThreadCount()
+
+    /* cannot be called while running
+     * a recording whose logs would overwrite the ones of a previous path
+     * (same base name into outputDir, or a.wav next to a.lkf) is not analysed
+     */
+    void start(const QStringList &paths);
+    void cancel(); // the running files are stopped at the next block
+    bool waitForDone(int msecs = -1);
+    bool isRunning() const;
+
+    QVector<BatchResult> results() const; // in the order given to start()
+    static bool writeSummary(const QString &path, const QVector<BatchResult> &results);
+
+signals:
+    // emitted from the worker threads
+    void fileDone(int index, int done, int total);
+    void finished();
+
+private:
+    friend class BatchTask;
+    void runTask(int index, const QString &path);
+    BatchResult analyse(const QString &path) const;
+    QString logBase(const QString &path) const; // without .lklog
+
+    QThreadPool _pool;
+    BatchSettings _settings;
+    mutable QMutex _mutex; // _results
+    QVector<BatchResult> _results;
+    std::atomic<bool> _cancel;
+    std::atomic<int> _done;
+    int _total;
+};
+
+#endif // BATCH_HPP
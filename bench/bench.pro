@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+
+SUBDIRS += bench_kernels.pro
+SUBDIRS += bench_engine.pro
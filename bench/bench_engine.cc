@@ -0,0 +1,202 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+/* End to end benchmark of Lockin
+ * The engine is fed with blocks of samples as fast as possible (synthetic or from a raw file)
+ * and the processing time of every block is recorded
+ * The latency is measured from the arrival of a block to the emission of newValue
+ */
+
+#include "benchutils.hh"
+#include "../lockin.hh"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <algorithm>
+
+static QJsonObject histogram(QVector<qint64> ns)
+{
+    QJsonObject h;
+    if (ns.isEmpty())
+        return h;
+
+    std::sort(ns.begin(), ns.end());
+    auto percentile = [&](qreal p) { return qreal(ns[qMin(ns.size() - 1, int(p * ns.size()))]) * 1e-3; };
+
+    qreal sum = 0.0;
+    for (qint64 x : ns)
+        sum += x;
+
+    h["count"] = ns.size();
+    h["mean_us"] = sum / ns.size() * 1e-3;
+    h["p50_us"] = percentile(0.50);
+    h["p99_us"] = percentile(0.99);
+    h["max_us"] = qreal(ns.last()) * 1e-3;
+    return h;
+}
+
+// false if the lockin rejects the format, nothing is measured
+static bool run(const QAudioFormat &format, QFile *input, qreal duration, qreal period,
+                qreal integrationTime, qreal chopper, QJsonObject *result)
+{
+    Lockin lockin;
+    lockin.setIntegrationTime(integrationTime);
+    if (!lockin.startOffline(format)) {
+        qWarning("the lockin does not accept the format %s at %d Hz", qPrintable(formatName(format)), format.sampleRate());
+        return false;
+    }
+
+    const int blockFrames = qMax(1, int(period * format.sampleRate()));
+    const qint64 totalFrames = qint64(duration * format.sampleRate());
+
+    QElapsedTimer timer;
+    qint64 arrival = 0;
+    int values = 0;
+    QVector<qint64> blockNs;
+    QVector<qint64> latencyNs;
+
+    QObject::connect(&lockin, &Lockin::newValue, [&](qreal, qreal) {
+        latencyNs << timer.nsecsElapsed() - arrival;
+        values++;
+    });
+
+    qint64 frames = 0;
+    qint64 busy = 0;
+    timer.start();
+    while (frames < totalFrames) {
+        QByteArray block;
+        if (input) {
+            block = input->read(qint64(blockFrames) * format.bytesPerFrame());
+            if (block.size() < format.bytesPerFrame())
+                break;
+            block.truncate(block.size() - block.size() % format.bytesPerFrame());
+        } else {
+            block = synthesizeStereo(format, blockFrames, chopper, frames);
+        }
+
+        arrival = timer.nsecsElapsed();
+        lockin.feed(block);
+        qint64 ns = timer.nsecsElapsed() - arrival;
+
+        blockNs << ns;
+        busy += ns;
+        frames += block.size() / format.bytesPerFrame();
+    }
+    lockin.stop();
+
+    qreal seconds = qreal(busy) * 1e-9;
+    qreal framesPerSec = qreal(frames) / seconds;
+
+    QJsonObject r;
+    r["format"] = formatName(format);
+    r["sample_rate"] = format.sampleRate();
+    r["block_frames"] = blockFrames;
+    r["frames"] = frames;
+    r["values"] = values;
+    r["processing_s"] = seconds;
+    r["frames_per_sec"] = framesPerSec;
+    r["max_rate_x_channels"] = framesPerSec * format.channelCount();
+    r["realtime_factor"] = framesPerSec / format.sampleRate();
+    r["block_time"] = histogram(blockNs);
+    r["latency"] = histogram(latencyNs);
+    *result = r;
+    return true;
+}
+
+static QAudioFormat::SampleType sampleType(const QString &s)
+{
+    if (s == "u") return QAudioFormat::UnSignedInt;
+    if (s == "f") return QAudioFormat::Float;
+    return QAudioFormat::SignedInt;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End to end throughput and latency benchmark of Lockin");
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Seconds of audio to process per configuration.", "seconds", "60");
+    QCommandLineOption periodOption("period", "Block length in seconds (output period).", "seconds", "0.1");
+    QCommandLineOption integrationOption("integration", "Integration time in seconds.", "seconds", "1");
+    QCommandLineOption chopperOption("chopper", "Chopper frequency in Hz.", "hz", "500");
+    QCommandLineOption ratesOption("rates", "Comma separated sample rates.", "list", "44100,96000,192000");
+    QCommandLineOption formatsOption("formats", "Comma separated formats (s16,s32,f32,...).", "list", "s16,s32,f32");
+    QCommandLineOption inputOption("input", "Raw interleaved stereo file instead of synthetic data "
+                                   "(little endian, first rate and format are used).", "file");
+    QCommandLineOption outputOption("output", "Write the JSON report into a file instead of stdout.", "file");
+    parser.addOptions({durationOption, periodOption, integrationOption, chopperOption,
+                       ratesOption, formatsOption, inputOption, outputOption});
+    parser.process(app);
+
+    QList<QAudioFormat> formats;
+    foreach (const QString &rate, parser.value(ratesOption).split(',', QString::SkipEmptyParts)) {
+        foreach (const QString &f, parser.value(formatsOption).split(',', QString::SkipEmptyParts)) {
+            formats << stereoFormat(sampleType(f.left(1)), f.mid(1).toInt(), rate.toInt());
+        }
+    }
+
+    QFile input(parser.value(inputOption));
+    if (parser.isSet(inputOption)) {
+        if (!input.open(QIODevice::ReadOnly)) {
+            qWarning("cannot open %s", qPrintable(input.fileName()));
+            return 1;
+        }
+        formats = formats.mid(0, 1);
+    }
+
+    QJsonArray runs;
+    foreach (const QAudioFormat &format, formats) {
+        QJsonObject r;
+        if (!run(format, parser.isSet(inputOption) ? &input : nullptr,
+                 parser.value(durationOption).toDouble(), parser.value(periodOption).toDouble(),
+                 parser.value(integrationOption).toDouble(), parser.value(chopperOption).toDouble(), &r))
+            return 1;
+        runs << r;
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "lockin_engine";
+    report["integration_time"] = parser.value(integrationOption).toDouble();
+    report["period"] = parser.value(periodOption).toDouble();
+    report["runs"] = runs;
+
+    QByteArray json = QJsonDocument(report).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning("cannot write %s", qPrintable(file.fileName()));
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    return 0;
+}
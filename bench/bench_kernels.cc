@@ -0,0 +1,148 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+/* Microbenchmark of the processing stages of Lockin
+ * decodeStereo, parseChopperSignal, mixSignal and the PrefixSum integrator
+ * are timed on synthetic data for several formats, block sizes and sample rates
+ */
+
+#include "benchutils.hh"
+#include "../dsp.hh"
+#include "../prefixsum.hh"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+static QTextStream out(stdout);
+static bool csv = false;
+
+static void report(const QString &stage, const QString &format, int rate, int block, const BenchResult &r)
+{
+    if (csv) {
+        out << stage << "," << format << "," << rate << "," << block << ","
+            << r.samplesPerSec << "," << r.nsPerSample << "," << r.cyclesPerSample << "\n";
+    } else {
+        out << qSetFieldWidth(12) << left << stage << qSetFieldWidth(8) << format
+            << qSetFieldWidth(8) << right << rate << qSetFieldWidth(8) << block
+            << qSetFieldWidth(14) << QString::number(r.samplesPerSec, 'e', 3)
+            << qSetFieldWidth(10) << QString::number(r.nsPerSample, 'f', 2)
+            << qSetFieldWidth(10) << QString::number(r.cyclesPerSample, 'f', 1)
+            << qSetFieldWidth(0) << "\n";
+    }
+    out.flush();
+}
+
+static QList<int> parseList(const QString &s)
+{
+    QList<int> list;
+    foreach (const QString &x, s.split(',', QString::SkipEmptyParts))
+        list << x.toInt();
+    return list;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmark of the lockin processing stages");
+    parser.addHelpOption();
+    QCommandLineOption minTimeOption("min-time", "Minimum time per measure in seconds.", "seconds", "0.2");
+    QCommandLineOption ratesOption("rates", "Comma separated sample rates.", "list", "44100,96000,192000");
+    QCommandLineOption blocksOption("blocks", "Comma separated block sizes in frames.", "list", "1024,8192,65536");
+    QCommandLineOption chopperOption("chopper", "Chopper frequency in Hz.", "hz", "500");
+    QCommandLineOption csvOption("csv", "Comma separated output.");
+    parser.addOptions({minTimeOption, ratesOption, blocksOption, chopperOption, csvOption});
+    parser.process(app);
+
+    qreal minTime = parser.value(minTimeOption).toDouble();
+    qreal chopper = parser.value(chopperOption).toDouble();
+    QList<int> rates = parseList(parser.value(ratesOption));
+    QList<int> blocks = parseList(parser.value(blocksOption));
+    csv = parser.isSet(csvOption);
+
+    if (csv) {
+        out << "stage,format,rate,block,samples_per_sec,ns_per_sample,cycles_per_sample\n";
+    } else {
+        out << qSetFieldWidth(12) << left << "stage" << qSetFieldWidth(8) << "format"
+            << qSetFieldWidth(8) << right << "rate" << qSetFieldWidth(8) << "block"
+            << qSetFieldWidth(14) << "samples/s" << qSetFieldWidth(10) << "ns/sample"
+            << qSetFieldWidth(10) << "cyc/sample" << qSetFieldWidth(0) << "\n";
+    }
+
+    const QList<QPair<QAudioFormat::SampleType, int>> types = {
+        {QAudioFormat::SignedInt, 8}, {QAudioFormat::SignedInt, 16}, {QAudioFormat::SignedInt, 32},
+        {QAudioFormat::UnSignedInt, 8}, {QAudioFormat::UnSignedInt, 16}, {QAudioFormat::UnSignedInt, 32},
+        {QAudioFormat::Float, 32}
+    };
+
+    foreach (int rate, rates) {
+        foreach (int block, blocks) {
+            // decoding depends only on the format
+            for (int k = 0; k < types.size(); ++k) {
+                QAudioFormat format = stereoFormat(types[k].first, types[k].second, rate);
+                QByteArray raw = synthesizeStereo(format, block, chopper);
+                QVector<QPair<qreal, qreal>> left_right;
+
+                BenchResult r = timeKernel([&]() {
+                    left_right.clear();
+                    decodeStereo(raw, format, false, left_right);
+                }, block, minTime);
+                report("decode", formatName(format), rate, block, r);
+            }
+
+            // the other stages work on decoded values, the chopper period depends on the rate
+            QAudioFormat format = stereoFormat(QAudioFormat::SignedInt, 16, rate);
+            QVector<QPair<qreal, qreal>> left_right;
+            decodeStereo(synthesizeStereo(format, block, chopper), format, false, left_right);
+            QVector<std::complex<qreal>> complex_exp;
+
+            BenchResult r = timeKernel([&]() {
+                parseChopperSignal(left_right, complex_exp);
+            }, block, minTime);
+            report("reference", formatName(format), rate, block, r);
+
+            QVector<std::complex<qreal>> mixed;
+            r = timeKernel([&]() {
+                mixSignal(left_right, complex_exp, mixed);
+            }, block, minTime);
+            report("mixer", formatName(format), rate, block, r);
+
+            // steady state of the integrator : a window of 1 second into a full history of 10 seconds
+            int sampleIntegration = rate;
+            PrefixSum integrator;
+            const int bucket = qMax(1, rate / 2000);
+            integrator.reset(0, bucket, qint64(10) * rate / bucket + 2);
+            for (int i = 0; i < 10 * rate / block + 1; ++i)
+                integrator.append(mixed.constData(), mixed.size());
+            r = timeKernel([&]() {
+                std::complex<qreal> x;
+                integrator.append(mixed.constData(), mixed.size());
+                integrator.mean(integrator.end(), sampleIntegration, &x);
+            }, block, minTime);
+            report("integrator", formatName(format), rate, block, r);
+        }
+    }
+
+    return 0;
+}
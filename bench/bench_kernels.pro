@@ -0,0 +1,14 @@
+QT += multimedia
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = bench_kernels
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include($$PWD/../engine.pri)
+
+SOURCES += bench_kernels.cc
+
+HEADERS += benchutils.hh
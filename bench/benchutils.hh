@@ -0,0 +1,164 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef BENCHUTILS_HPP
+#define BENCHUTILS_HPP
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QString>
+#include <cmath>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_CYCLES 1
+#else
+#define BENCH_HAS_CYCLES 0
+#endif
+
+// time stamp counter, 0 when the architecture does not provide one
+inline quint64 readCycles()
+{
+#if BENCH_HAS_CYCLES
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct BenchResult {
+    qreal samplesPerSec;
+    qreal nsPerSample;
+    qreal cyclesPerSample; // NAN when not available
+};
+
+/* Call kernel() until minSeconds are elapsed (at least 3 times)
+ * each call processes samplesPerCall samples
+ */
+template <typename F>
+BenchResult timeKernel(F kernel, qint64 samplesPerCall, qreal minSeconds)
+{
+    kernel(); // warm up caches and allocations
+
+    QElapsedTimer timer;
+    qint64 calls = 0;
+    timer.start();
+    quint64 c0 = readCycles();
+    do {
+        kernel();
+        calls++;
+    } while (calls < 3 || timer.nsecsElapsed() < qint64(minSeconds * 1e9));
+    quint64 c1 = readCycles();
+    qint64 ns = timer.nsecsElapsed();
+
+    qreal samples = qreal(calls) * qreal(samplesPerCall);
+    BenchResult r;
+    r.nsPerSample = qreal(ns) / samples;
+    r.samplesPerSec = samples / (qreal(ns) * 1e-9);
+    r.cyclesPerSample = BENCH_HAS_CYCLES ? qreal(c1 - c0) / samples : NAN;
+    return r;
+}
+
+inline QString formatName(const QAudioFormat &format)
+{
+    QString type;
+    switch (format.sampleType()) {
+    case QAudioFormat::SignedInt: type = "s"; break;
+    case QAudioFormat::UnSignedInt: type = "u"; break;
+    case QAudioFormat::Float: type = "f"; break;
+    case QAudioFormat::Unknown: type = "?"; break;
+    }
+    return type + QString::number(format.sampleSize())
+            + (format.byteOrder() == QAudioFormat::LittleEndian ? "le" : "be");
+}
+
+inline QAudioFormat stereoFormat(QAudioFormat::SampleType type, int size, int rate)
+{
+    QAudioFormat format;
+    format.setCodec("audio/pcm");
+    format.setChannelCount(2);
+    format.setSampleRate(rate);
+    format.setSampleSize(size);
+    format.setSampleType(type);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    return format;
+}
+
+/* Encode a synthetic lockin input
+ * left : signal in phase with the chopper plus noise
+ * right : chopper (sine at chopperFrequency)
+ * firstFrame allows to generate a continuous stream block after block
+ */
+inline QByteArray synthesizeStereo(const QAudioFormat &format, int frames, qreal chopperFrequency,
+                                   qint64 firstFrame = 0, qreal amplitude = 0.1, qreal noise = 0.05)
+{
+    static std::mt19937 gen(42);
+    std::normal_distribution<qreal> gauss(0.0, noise);
+
+    QByteArray raw;
+    raw.reserve(frames * format.bytesPerFrame());
+    QDataStream out(&raw, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::ByteOrder(format.byteOrder()));
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    qreal middle = std::ldexp(1.0, format.sampleSize() - 1);
+    qreal w = 2.0 * M_PI * chopperFrequency / qreal(format.sampleRate());
+
+    for (int i = 0; i < frames; ++i) {
+        qreal phase = w * qreal(firstFrame + i);
+        qreal values[2];
+        values[0] = qBound(-0.99, amplitude * std::sin(phase + 0.3) + gauss(gen), 0.99);
+        values[1] = 0.8 * std::sin(phase);
+
+        for (qreal v : values) {
+            switch (format.sampleType()) {
+            case QAudioFormat::Float:
+                out << float(v);
+                break;
+            case QAudioFormat::SignedInt:
+                switch (format.sampleSize()) {
+                case 8: out << qint8(std::lround(v * middle)); break;
+                case 16: out << qint16(std::lround(v * middle)); break;
+                case 32: out << qint32(std::llround(v * middle)); break;
+                }
+                break;
+            case QAudioFormat::UnSignedInt:
+                switch (format.sampleSize()) {
+                case 8: out << quint8(std::lround((v + 1.0) * middle)); break;
+                case 16: out << quint16(std::lround((v + 1.0) * middle)); break;
+                case 32: out << quint32(std::llround((v + 1.0) * middle)); break;
+                }
+                break;
+            case QAudioFormat::Unknown:
+                break;
+            }
+        }
+    }
+
+    return raw;
+}
+
+#endif // BENCHUTILS_HPP
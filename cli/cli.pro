@@ -0,0 +1,4 @@
+TEMPLATE = subdirs
+
+SUBDIRS += lockin_cli.pro
+SUBDIRS += lockin_shm_tail.pro
@@ -0,0 +1,349 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+/* Headless lockin : no widget, no display
+ * Measures from an audio input (or a recording with --replay)
+ * and streams the outputs as text lines to stdout or a file,
+ * and optionally into a binary measure log (.lklog, channel 0)
+ */
+
+#include "../batch.hh"
+#include "../lockin.hh"
+#include "../measurelog.hh"
+#include "../measureserver.hh"
+#include "../replay.hh"
+#include <QAudioDeviceInfo>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QTimer>
+#include <cmath>
+#include <csignal>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onSignal(int)
+{
+    interrupted = 1;
+}
+
+static QAudioDeviceInfo findDevice(const QString &name)
+{
+    if (name.isEmpty())
+        return QAudioDeviceInfo::defaultInputDevice();
+
+    foreach (const QAudioDeviceInfo &device, QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+        if (device.deviceName() == name)
+            return device;
+    }
+    foreach (const QAudioDeviceInfo &device, QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+        if (device.deviceName().contains(name))
+            return device;
+    }
+    return QAudioDeviceInfo();
+}
+
+static void listDevices(QTextStream &out)
+{
+    foreach (const QAudioDeviceInfo &device, QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+        QStringList rates, sizes;
+        foreach (int rate, device.supportedSampleRates())
+            rates << QString::number(rate);
+        foreach (int size, device.supportedSampleSizes())
+            sizes << QString::number(size);
+        out << device.deviceName() << "\n"
+            << "    rates " << rates.join(',') << "\n"
+            << "    sizes " << sizes.join(',') << "\n";
+    }
+}
+
+static QVector<qreal> parseTimes(const QString &list)
+{
+    QVector<qreal> times;
+    foreach (const QString &word, list.split(',', QString::SkipEmptyParts)) {
+        bool ok;
+        qreal t = word.toDouble(&ok);
+        if (!ok || t <= 0.0) {
+            qDebug() << __FUNCTION__ << ": ignore integration time" << word;
+            continue;
+        }
+        if (t > maxIntegrationTime) {
+            qDebug() << __FUNCTION__ << ": integration time" << word << "clamped to" << maxIntegrationTime;
+            t = maxIntegrationTime;
+        }
+        times << t;
+    }
+    return times;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("lockin_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless lockin, writes one line per output: "
+                                     "time [s], channel, X, Y, R, flags (and the system time in ns with --system-clock)");
+    parser.addHelpOption();
+    QCommandLineOption listOption("list", "List the audio inputs and their formats, then quit.");
+    QCommandLineOption deviceOption(QStringList() << "d" << "device", "Audio input (exact name or part of it), default input if not set.", "name");
+    QCommandLineOption rateOption(QStringList() << "r" << "rate", "Sample rate in Hz.", "hz", "44100");
+    QCommandLineOption sizeOption(QStringList() << "b" << "bits", "Sample size in bits.", "bits", "16");
+    QCommandLineOption integrationOption(QStringList() << "t" << "integration", "Integration time in seconds (channel 0).", "seconds", "1");
+    QCommandLineOption extraOption("extra", "Comma separated integration times of the channels 1, 2, ...", "list");
+    QCommandLineOption periodOption(QStringList() << "p" << "period", "Output period in seconds.", "seconds", "0.5");
+    QCommandLineOption durationOption("duration", "Stop after this time in seconds (0 : until interrupted).", "seconds", "0");
+    QCommandLineOption invertOption("invert", "Swap left (signal) and right (chopper) channels.");
+    QCommandLineOption clockOption("system-clock", "Stamp the outputs with the steady clock of the system too.");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the text lines into a file instead of stdout.", "file");
+    QCommandLineOption logOption("log", "Write channel 0 into a binary measure log (.lklog).", "file");
+    QCommandLineOption recordOption("record", "Record the raw stream (.wav or .lkf).", "file");
+    QCommandLineOption replayOption("replay", "Analyse a recording (.wav or .lkf) instead of an audio input.", "file");
+    QCommandLineOption publishOption("publish", "Publish the outputs to other processes (local socket name or tcp:port).", "address");
+    QCommandLineOption shmOption("shm", "Write the outputs into a shared memory ring too (name like /lockin, see shmring.hh).", "name");
+    QCommandLineOption batchOption("batch", "Analyse all the recordings (.wav, .lkf) of a directory in parallel, "
+                                   "one .lklog per file and channel and a summary table.", "dir");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Files analysed at the same time with --batch (default : cores).", "n");
+    QCommandLineOption logDirOption("log-dir", "Directory of the logs of --batch (default : next to the recordings).", "dir");
+    QCommandLineOption summaryOption("summary", "Summary table of --batch (default : summary.tsv into the directory).", "file");
+    QCommandLineOption recursiveOption("recursive", "--batch goes into the subdirectories.");
+    QCommandLineOption quietOption(QStringList() << "q" << "quiet", "No text output (with --log or --record).");
+    parser.addOptions({listOption, deviceOption, rateOption, sizeOption, integrationOption, extraOption,
+                       periodOption, durationOption, invertOption, clockOption, outputOption, logOption,
+                       recordOption, replayOption, publishOption, shmOption, batchOption, jobsOption, logDirOption, summaryOption,
+                       recursiveOption, quietOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    if (parser.isSet(listOption)) {
+        QTextStream out(stdout);
+        listDevices(out);
+        return 0;
+    }
+
+    // the integrator grows with the longest time, see parseTimes too
+    if (parser.value(integrationOption).toDouble() > maxIntegrationTime)
+        err << "integration time clamped to " << maxIntegrationTime << " s\n";
+
+    if (parser.isSet(batchOption)) {
+        const QString dir = parser.value(batchOption);
+        const QStringList paths = BatchAnalysis::recordings(dir, parser.isSet(recursiveOption));
+        if (paths.isEmpty()) {
+            err << "no recording into " << dir << "\n";
+            return 1;
+        }
+
+        BatchSettings settings;
+        settings.integrationTime = qMin(parser.value(integrationOption).toDouble(), maxIntegrationTime);
+        settings.extraIntegrationTimes = parseTimes(parser.value(extraOption));
+        settings.outputPeriod = parser.value(periodOption).toDouble();
+        settings.invertLR = parser.isSet(invertOption);
+        settings.outputDir = parser.value(logDirOption);
+
+        BatchAnalysis batch;
+        batch.setSettings(settings);
+        if (parser.isSet(jobsOption))
+            batch.setMaxThreads(parser.value(jobsOption).toInt());
+        // called by the workers, there is no event loop here
+        QMutex errMutex;
+        QObject::connect(&batch, &BatchAnalysis::fileDone, [&](int index, int done, int total) {
+            QMutexLocker lock(&errMutex);
+            err << done << "/" << total << " " << paths[index] << "\n";
+            err.flush();
+        });
+
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        batch.start(paths);
+        while (!batch.waitForDone(100)) {
+            if (interrupted)
+                batch.cancel();
+        }
+
+        const QVector<BatchResult> results = batch.results();
+        const QString summary = parser.isSet(summaryOption) ? parser.value(summaryOption) : dir + "/summary.tsv";
+        if (!BatchAnalysis::writeSummary(summary, results)) {
+            err << "cannot write " << summary << "\n";
+            return 1;
+        }
+        int failed = 0;
+        foreach (const BatchResult &r, results)
+            failed += r.ok ? 0 : 1;
+        err << results.size() - failed << " files analysed, " << failed << " failed, summary into " << summary << "\n";
+        return failed == 0 ? 0 : 1;
+    }
+
+    QFile output;
+    if (parser.isSet(outputOption)) {
+        output.setFileName(parser.value(outputOption));
+        if (!output.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            err << "cannot write " << output.fileName() << "\n";
+            return 1;
+        }
+    } else {
+        output.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    QTextStream out(&output);
+    out.setRealNumberPrecision(10);
+    const bool quiet = parser.isSet(quietOption);
+    const bool systemClock = parser.isSet(clockOption);
+
+    const qreal integrationTime = qMin(parser.value(integrationOption).toDouble(), maxIntegrationTime);
+    const qreal outputPeriod = parser.value(periodOption).toDouble();
+
+    Lockin lockin;
+    lockin.setInvertLR(parser.isSet(invertOption));
+    lockin.setSystemClockTimestamps(systemClock);
+    lockin.setIntegrationTime(integrationTime);
+    lockin.setExtraIntegrationTimes(parseTimes(parser.value(extraOption)));
+
+    if (parser.isSet(shmOption) && !lockin.startSharedMemory(parser.value(shmOption))) {
+        err << "cannot create the shared memory " << parser.value(shmOption) << "\n";
+        return 1;
+    }
+
+    MeasureLogWriter log;
+
+    MeasureServer server;
+    if (parser.isSet(publishOption)) {
+        if (!server.listen(parser.value(publishOption))) {
+            err << "cannot listen on " << parser.value(publishOption) << "\n";
+            return 1;
+        }
+        QObject::connect(&lockin, &Lockin::newMeasure, &server, &MeasureServer::publish);
+    }
+
+    QObject::connect(&lockin, &Lockin::newMeasure, [&](const LockinMeasure &m) {
+        if (m.channel == 0 && log.isOpen())
+            log.append(m);
+        if (quiet)
+            return;
+        out << m.time << '\t' << m.channel << '\t' << m.value.real() << '\t' << m.value.imag()
+            << '\t' << std::abs(m.value) << '\t' << m.flags;
+        if (systemClock)
+            out << '\t' << m.systemTimeNs;
+        out << '\n';
+        out.flush(); // one line per output period, for the pipes
+    });
+
+    if (parser.isSet(replayOption)) {
+        Replay replay;
+        if (!replay.open(parser.value(replayOption), parser.isSet(invertOption))) {
+            err << "cannot read " << parser.value(replayOption) << "\n";
+            return 1;
+        }
+        if (parser.isSet(logOption) && !log.open(parser.value(logOption), replay.format().sampleRate(), integrationTime, outputPeriod)) {
+            err << "cannot write " << parser.value(logOption) << "\n";
+            return 1;
+        }
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        bool ok = replay.run(&lockin, outputPeriod, 0, -1, [](qreal) { return !interrupted; });
+        if (!ok && !interrupted)
+            err << "the analysis of " << parser.value(replayOption) << " is incomplete\n";
+        log.setReferenceFrequency(replay.index().meanFrequency());
+        log.close();
+        if (log.hasError()) {
+            err << "write error, " << parser.value(logOption) << " is incomplete\n";
+            return 1;
+        }
+        return ok || interrupted ? 0 : 1;
+    }
+
+    QAudioDeviceInfo device = findDevice(parser.value(deviceOption));
+    if (device.isNull()) {
+        err << "no audio input " << parser.value(deviceOption) << "\n";
+        return 1;
+    }
+
+    QAudioFormat format = device.preferredFormat();
+    format.setChannelCount(2);
+    format.setCodec("audio/pcm");
+    format.setSampleRate(parser.value(rateOption).toInt());
+    format.setSampleSize(parser.value(sizeOption).toInt());
+    if (!device.isFormatSupported(format)) {
+        err << "format not supported by " << device.deviceName() << ", see --list\n";
+        return 1;
+    }
+
+    if (!lockin.start(device, format, int(outputPeriod * 1000.0))) {
+        err << "cannot start the lockin\n";
+        return 1;
+    }
+    if (parser.isSet(logOption) && !log.open(parser.value(logOption), format.sampleRate(), integrationTime, outputPeriod)) {
+        err << "cannot write " << parser.value(logOption) << "\n";
+        return 1;
+    }
+    if (parser.isSet(recordOption) && !lockin.startRecording(parser.value(recordOption))) {
+        err << "cannot record into " << parser.value(recordOption) << "\n";
+        return 1;
+    }
+    err << "measuring on " << device.deviceName() << ", Ctrl-C to stop\n";
+    err.flush();
+
+    // a signal handler cannot touch Qt, it is polled from the event loop
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [&]() {
+        if (interrupted)
+            app.quit();
+    });
+    poll.start(100);
+
+    const qreal duration = parser.value(durationOption).toDouble();
+    if (duration > 0.0)
+        QTimer::singleShot(int(duration * 1000.0), &app, &QCoreApplication::quit);
+
+    app.exec();
+
+    if (log.isOpen()) {
+        log.setReferenceFrequency(lockin.referenceFrequency());
+        log.close();
+        if (log.hasError())
+            err << "write error, " << parser.value(logOption) << " is incomplete\n";
+    }
+    // after stop : the recorder writes its last chunk and its header there
+    lockin.stop();
+    LockinStats stats = lockin.stats();
+
+    err << stats.blocks << " blocks, " << stats.samples << " samples, "
+        << stats.gaps << " gaps (" << stats.droppedSamples << " samples lost), "
+        << stats.lateBlocks << " late blocks, " << stats.overruns << " overruns";
+    if (!std::isnan(stats.clockPpm))
+        err << ", clock " << stats.clockPpm << " ppm";
+    if (server.isListening())
+        err << ", " << server.stats().droppedFrames << " frames not published";
+    if (stats.recorderDropped > 0)
+        err << ", " << stats.recorderDropped << " bytes not recorded";
+    if (stats.recorderError)
+        err << ", write error, " << parser.value(recordOption) << " is incomplete";
+    err << "\n";
+
+    return log.hasError() || stats.recorderError ? 1 : 0;
+}
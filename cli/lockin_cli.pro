@@ -0,0 +1,13 @@
+QT -= gui
+QT += multimedia
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = lockin_cli
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include($$PWD/../engine.pri)
+
+SOURCES += lockin_cli.cc
@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+/* Example client of the shared memory ring, without Qt
+ * Prints the outputs written by a lockin started with --shm (or Shared memory in the GUI)
+ * the records are read from the mapping : no system call per record
+ */
+
+#include "../shmring.hh"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        printf("usage: %s [name] [poll interval in us]\n"
+               "prints time [s], channel, X, Y, R, flags of every new output of the ring (default /lockin)\n", argv[0]);
+        return 0;
+    }
+    const char *name = argc > 1 ? argv[1] : "/lockin";
+    const int pollUs = argc > 2 ? atoi(argv[2]) : 1000;
+
+    ShmRingReader reader;
+    if (!reader.open(name))
+        return 1;
+
+    uint64_t lost = 0;
+    ShmRingRecord r;
+    for (;;) {
+        bool any = false;
+        while (reader.next(&r)) {
+            printf("%.10g\t%u\t%.10g\t%.10g\t%.10g\t%u\n", r.time, r.channel, r.x, r.y, std::hypot(r.x, r.y), r.flags);
+            any = true;
+        }
+        if (reader.lost() != lost) {
+            fprintf(stderr, "%llu records lost\n", static_cast<unsigned long long>(reader.lost() - lost));
+            lost = reader.lost();
+        }
+        if (any) {
+            fflush(stdout);
+        } else if (reader.isStale()) {
+            fprintf(stderr, "the lockin did restart, reopen %s\n", name);
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (!reader.open(name))
+                return 1;
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(pollUs));
+        }
+    }
+}
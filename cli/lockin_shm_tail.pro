@@ -0,0 +1,12 @@
+CONFIG -= qt
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = lockin_shm_tail
+
+unix:!macx: LIBS += -lrt
+
+SOURCES += lockin_shm_tail.cc \
+    $$PWD/../shmring.cc
+
+HEADERS += $$PWD/../shmring.hh
@@ -0,0 +1,133 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "clockestimator.hh"
+#include <cmath>
+
+ClockEstimator::ClockEstimator()
+{
+    reset(44100.0);
+}
+
+void ClockEstimator::reset(qreal nominalRate, qreal window, qreal timeConstant)
+{
+    _nominalNsPerSample = 1e9 / nominalRate;
+    _window = window * 1e9;
+    _timeConstant = timeConstant * 1e9;
+
+    _originSample = 0;
+    _originNs = 0;
+    _hasOrigin = false;
+    _windowStart = 0.0;
+    _bestX = _bestY = 0.0;
+    _hasBest = false;
+
+    _points = 0;
+    _lastY = 0.0;
+    _w = 0.0;
+    _mx = _my = 0.0;
+    _cxx = _cxy = 0.0;
+    _slope = _nominalNsPerSample;
+}
+
+void ClockEstimator::observe(qint64 sample, qint64 ns)
+{
+    if (!_hasOrigin) {
+        _originSample = sample;
+        _originNs = ns;
+        _hasOrigin = true;
+        fit(0.0, 0.0);
+        return;
+    }
+
+    const qreal x = qreal(sample - _originSample);
+    const qreal y = qreal(ns - _originNs);
+
+    // the earliest arrival relative to the current line
+    if (!_hasBest || y - x * _slope < _bestY - _bestX * _slope) {
+        _bestX = x;
+        _bestY = y;
+        _hasBest = true;
+    }
+
+    if (y - _windowStart >= _window) {
+        fit(_bestX, _bestY);
+        _windowStart = y;
+        _hasBest = false;
+    }
+}
+
+void ClockEstimator::fit(qreal x, qreal y)
+{
+    if (_points > 0) {
+        const qreal decay = std::exp(-(y - _lastY) / _timeConstant);
+        _w *= decay;
+        _cxx *= decay;
+        _cxy *= decay;
+    }
+    _lastY = y;
+    _points++;
+
+    _w += 1.0;
+    const qreal dx = x - _mx;
+    _mx += dx / _w;
+    _my += (y - _my) / _w;
+    _cxx += dx * (x - _mx);
+    _cxy += dx * (y - _my);
+
+    if (isValid())
+        _slope = _cxy / _cxx;
+}
+
+bool ClockEstimator::hasAnchor() const
+{
+    return _hasOrigin;
+}
+
+bool ClockEstimator::isValid() const
+{
+    return _points >= 3 && _cxx > 0.0;
+}
+
+qreal ClockEstimator::rate() const
+{
+    return 1e9 / _slope;
+}
+
+qreal ClockEstimator::ppm() const
+{
+    return (_nominalNsPerSample / _slope - 1.0) * 1e6;
+}
+
+qint64 ClockEstimator::toNs(qreal sample) const
+{
+    const qreal x = sample - qreal(_originSample);
+    return _originNs + qint64(std::llround(_my + (x - _mx) * _slope));
+}
+
+qreal ClockEstimator::toSample(qint64 ns) const
+{
+    const qreal y = qreal(ns - _originNs);
+    return qreal(_originSample) + _mx + (y - _my) / _slope;
+}
@@ -0,0 +1,85 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef CLOCKESTIMATOR_HPP
+#define CLOCKESTIMATOR_HPP
+
+#include <QtGlobal>
+
+/* True rate of a sound card against the steady clock of the system
+ *
+ * Each block gives a pair (sample index reached, arrival time). The arrival is late
+ * by a random latency, so only the earliest pair of each window is kept (the least delayed),
+ * and a line ns = f(sample) is fitted over these pairs with an exponential forgetting
+ * that follows the slow drift of the crystal (temperature).
+ * Two devices mapped on the steady clock share the same time base.
+ */
+
+class ClockEstimator
+{
+public:
+    ClockEstimator();
+
+    // window : one pair is kept per window [s], timeConstant : memory of the fit [s]
+    void reset(qreal nominalRate, qreal window = 2.0, qreal timeConstant = 600.0);
+    void observe(qint64 sample, qint64 ns);
+
+    bool hasAnchor() const; // at least one pair, toNs() uses the nominal rate
+    bool isValid() const; // the rate is measured
+    qreal rate() const; // [Hz] on the steady clock, the nominal one until valid
+    qreal ppm() const; // (rate / nominal - 1) * 1e6
+
+    qint64 toNs(qreal sample) const;
+    qreal toSample(qint64 ns) const;
+
+private:
+    void fit(qreal x, qreal y);
+
+    qreal _nominalNsPerSample;
+    qreal _window; // [ns]
+    qreal _timeConstant; // [ns]
+
+    // the fit is done relative to the first pair, for the precision
+    qint64 _originSample;
+    qint64 _originNs;
+    bool _hasOrigin;
+
+    // earliest pair of the current window
+    qreal _windowStart; // [ns from origin]
+    qreal _bestX;
+    qreal _bestY;
+    bool _hasBest;
+
+    // exponentially weighted means and co-moments (West's incremental algorithm)
+    int _points;
+    qreal _lastY;
+    qreal _w;
+    qreal _mx;
+    qreal _my;
+    qreal _cxx;
+    qreal _cxy;
+    qreal _slope; // [ns per sample]
+};
+
+#endif // CLOCKESTIMATOR_HPP
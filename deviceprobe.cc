@@ -0,0 +1,104 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "deviceprobe.hh"
+#include <QSettings>
+#include <QStringList>
+#include <QUrl>
+
+// the names contain '/' and ':' that QSettings would take as groups
+static QString settingsKey(const QString &name)
+{
+    return QString::fromLatin1(QUrl::toPercentEncoding(name));
+}
+
+static QVariantList toVariantList(const QList<int> &values)
+{
+    QVariantList list;
+    foreach (int v, values)
+        list << v;
+    return list;
+}
+
+static QList<int> fromVariantList(const QVariant &value)
+{
+    QList<int> list;
+    foreach (const QVariant &v, value.toList())
+        list << v.toInt();
+    return list;
+}
+
+DeviceProbe::DeviceProbe(QObject *parent) : QObject(parent)
+{
+}
+
+QList<DeviceCapabilities> DeviceProbe::cached()
+{
+    QSettings set;
+    QList<DeviceCapabilities> devices;
+
+    // the order of the enumeration is kept into "order"
+    foreach (const QString &name, set.value("audio devices/order").toStringList()) {
+        set.beginGroup("audio devices/" + settingsKey(name));
+        DeviceCapabilities c;
+        c.name = name;
+        c.sampleRates = fromVariantList(set.value("rates"));
+        c.sampleSizes = fromVariantList(set.value("sizes"));
+        set.endGroup();
+        devices << c;
+    }
+    return devices;
+}
+
+void DeviceProbe::store(const QList<DeviceCapabilities> &devices)
+{
+    QSettings set;
+    set.remove("audio devices");
+
+    QStringList order;
+    foreach (const DeviceCapabilities &c, devices) {
+        set.beginGroup("audio devices/" + settingsKey(c.name));
+        set.setValue("rates", toVariantList(c.sampleRates));
+        set.setValue("sizes", toVariantList(c.sampleSizes));
+        set.endGroup();
+        order << c.name;
+    }
+    set.setValue("audio devices/order", order);
+}
+
+void DeviceProbe::probe()
+{
+    QList<DeviceCapabilities> devices;
+
+    foreach (const QAudioDeviceInfo &device, QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
+        DeviceCapabilities c;
+        c.name = device.deviceName();
+        c.sampleRates = device.supportedSampleRates();
+        c.sampleSizes = device.supportedSampleSizes();
+        c.device = device;
+        devices << c;
+    }
+
+    emit ready(devices);
+}
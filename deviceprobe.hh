@@ -0,0 +1,64 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef DEVICEPROBE_HPP
+#define DEVICEPROBE_HPP
+
+#include <QObject>
+#include <QList>
+#include <QAudioDeviceInfo>
+
+/* Enumeration of the audio inputs off the GUI thread
+ * availableDevices() and supportedSampleRates() can block for seconds (PulseAudio, ALSA),
+ * the GUI shows the capabilities of the last run (cached()) until probe() answers
+ * and cannot start the lockin before : the cached devices have no QAudioDeviceInfo.
+ */
+
+struct DeviceCapabilities {
+    QString name;
+    QList<int> sampleRates;
+    QList<int> sampleSizes;
+    QAudioDeviceInfo device; // null when it comes from the cache
+};
+Q_DECLARE_METATYPE(DeviceCapabilities)
+Q_DECLARE_METATYPE(QList<DeviceCapabilities>)
+
+// lives into a worker thread
+class DeviceProbe : public QObject {
+    Q_OBJECT
+public:
+    explicit DeviceProbe(QObject *parent = 0);
+
+    // QSettings "audio devices", keyed by device name
+    static QList<DeviceCapabilities> cached();
+    static void store(const QList<DeviceCapabilities> &devices);
+
+public slots:
+    void probe();
+
+signals:
+    void ready(const QList<DeviceCapabilities> &devices);
+};
+
+#endif // DEVICEPROBE_HPP
@@ -0,0 +1,198 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "dsp.hh"
+#include <QDataStream>
+#include <cmath>
+#include <algorithm>
+
+template <typename T>
+static void readPairs(QDataStream &in, qreal middle, qreal offset, bool invertLR,
+                      QVector<QPair<qreal, qreal>> &left_right)
+{
+    T value;
+    QPair<qreal,qreal> pair;
+
+    while (!in.atEnd()) {
+        in >> value;
+        pair.first = (qreal(value) / middle) - offset;
+        in >> value;
+        pair.second = (qreal(value) / middle) - offset;
+        if (invertLR) {
+            std::swap(pair.first, pair.second);
+        }
+        left_right.append(pair);
+    }
+}
+
+void decodeStereo(const QByteArray &raw, const QAudioFormat &format, bool invertLR,
+                  QVector<QPair<qreal, qreal>> &left_right)
+{
+    qreal middle = 0;
+
+    switch (format.sampleSize()) {
+    case 8:
+        middle = 128;
+        Q_ASSERT(raw.size() % 2 == 0);
+        break;
+    case 16:
+        middle = 32768;
+        Q_ASSERT((raw.size() / 2) % 2 == 0);
+        break;
+    case 32:
+        middle = 2147483648;
+        Q_ASSERT((raw.size() / 4) % 2 == 0);
+        break;
+    }
+
+    if (format.bytesPerFrame() > 0)
+        left_right.reserve(left_right.size() + raw.size() / format.bytesPerFrame());
+
+    QDataStream in(raw);
+    in.setByteOrder(QDataStream::ByteOrder(format.byteOrder()));
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision); // otherwise operator>>(float&) reads doubles
+
+    switch (format.sampleType()) {
+    case QAudioFormat::Float:
+        readPairs<float>(in, 1.0, 0.0, invertLR, left_right);
+        break;
+    case QAudioFormat::SignedInt:
+        switch (format.sampleSize()) {
+        case 8:
+            readPairs<qint8>(in, middle, 0.0, invertLR, left_right);
+            break;
+        case 16:
+            readPairs<qint16>(in, middle, 0.0, invertLR, left_right);
+            break;
+        case 32:
+            readPairs<qint32>(in, middle, 0.0, invertLR, left_right);
+            break;
+        }
+        break;
+    case QAudioFormat::UnSignedInt:
+        switch (format.sampleSize()) {
+        case 8:
+            readPairs<quint8>(in, middle, 1.0, invertLR, left_right);
+            break;
+        case 16:
+            readPairs<quint16>(in, middle, 1.0, invertLR, left_right);
+            break;
+        case 32:
+            readPairs<quint32>(in, middle, 1.0, invertLR, left_right);
+            break;
+        }
+        break;
+    case QAudioFormat::Unknown:
+        break;
+    }
+}
+
+int parseChopperSignal(const QVector<QPair<qreal, qreal>> &left_right,
+                        QVector<std::complex<qreal>> &complex_exp)
+{
+    complex_exp.clear();
+    complex_exp.reserve(left_right.size());
+
+    int i = 0;
+
+    // set the first value as ignored
+    complex_exp << NAN;
+    i++;
+
+    for (; i < left_right.size(); ++i) {
+        if (left_right[i-1].second < 0.0 && left_right[i].second >= 0.0) {
+            // first rising edge
+            break;
+        }
+        complex_exp << NAN;
+    }
+
+    int periodSize = 0;
+    int edges = 0;
+    for (; i < left_right.size(); ++i) {
+        periodSize++;
+        if (left_right[i-1].second < 0.0 && left_right[i].second >= 0.0) {
+            // rising edge
+            edges++;
+
+            for (int j = 0; j < periodSize; ++j) {
+                qreal angle = 2.0 * M_PI * qreal(j) / qreal(periodSize);
+                complex_exp << std::exp(std::complex<qreal>(0.0, 1.0) * angle);
+            }
+
+            periodSize = 0;
+        }
+    }
+
+    for (int j = 0; j < periodSize; ++j) {
+        complex_exp << NAN;
+    }
+
+    Q_ASSERT(complex_exp.size() == left_right.size());
+
+    // the first edge closes an empty period
+    return qMax(0, edges - 1);
+}
+
+void referenceFromEdges(const QVector<double> &edges, qint64 firstFrame, int frames,
+                        QVector<std::complex<qreal>> &complex_exp)
+{
+    complex_exp.resize(frames);
+
+    // k : last edge at or before the frame
+    int k = int(std::upper_bound(edges.constBegin(), edges.constEnd(), double(firstFrame)) - edges.constBegin()) - 1;
+
+    for (int i = 0; i < frames; ++i) {
+        const double t = double(firstFrame + i);
+        while (k + 1 < edges.size() && edges[k + 1] <= t)
+            k++;
+
+        if (k < 0 || k + 1 >= edges.size()) {
+            complex_exp[i] = NAN;
+        } else {
+            qreal angle = 2.0 * M_PI * (t - edges[k]) / (edges[k + 1] - edges[k]);
+            complex_exp[i] = std::exp(std::complex<qreal>(0.0, 1.0) * angle);
+        }
+    }
+}
+
+int mixSignal(const QVector<QPair<qreal, qreal>> &left_right,
+              const QVector<std::complex<qreal>> &complex_exp,
+              QVector<std::complex<qreal>> &mixed)
+{
+    Q_ASSERT(complex_exp.size() == left_right.size());
+
+    mixed.resize(left_right.size());
+    int valid = 0;
+
+    for (int i = 0; i < left_right.size(); ++i) {
+        std::complex<qreal> x = complex_exp[i] * left_right[i].first;
+        mixed[i] = x;
+
+        if (!std::isnan(x.real()) && !std::isnan(x.imag())) {
+            ++valid;
+        }
+    }
+
+    return valid;
+}
@@ -0,0 +1,58 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef DSP_HPP
+#define DSP_HPP
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QVector>
+#include <QPair>
+#include <complex>
+
+/* Processing stages of the lockin
+ * They are kept free of any state so that they can be
+ * timed and tested outside of a running Lockin
+ */
+
+// decode interleaved stereo samples and cast them in the interval (-1, 1)
+void decodeStereo(const QByteArray &raw, const QAudioFormat &format, bool invertLR,
+                  QVector<QPair<qreal, qreal>> &left_right);
+
+// build sin/cos from the rising edges of the right channel, NAN outside of complete periods
+// returns the number of complete periods
+int parseChopperSignal(const QVector<QPair<qreal, qreal>> &left_right,
+                        QVector<std::complex<qreal>> &complex_exp);
+
+// same as parseChopperSignal from known rising edges (sorted, in frames, interpolated)
+// for the frames [firstFrame, firstFrame + frames), the phase is interpolated between the edges
+void referenceFromEdges(const QVector<double> &edges, qint64 firstFrame, int frames,
+                        QVector<std::complex<qreal>> &complex_exp);
+
+// product of the left channel with sin/cos, NAN where the reference is NAN
+// returns the number of valid (not NAN) values
+int mixSignal(const QVector<QPair<qreal, qreal>> &left_right,
+              const QVector<std::complex<qreal>> &complex_exp,
+              QVector<std::complex<qreal>> &mixed);
+
+#endif // DSP_HPP
@@ -0,0 +1,40 @@
+QT += network
+
+unix:!macx: LIBS += -lrt
+
+SOURCES += $$PWD/fifo.cc \
+    $$PWD/batch.cc \
+    $$PWD/clockestimator.cc \
+    $$PWD/dsp.cc \
+    $$PWD/lockin.cc \
+    $$PWD/lockingroup.cc \
+    $$PWD/lossless.cc \
+    $$PWD/measurelog.cc \
+    $$PWD/measureserver.cc \
+    $$PWD/phaseaverager.cc \
+    $$PWD/prefixsum.cc \
+    $$PWD/recorder.cc \
+    $$PWD/recording.cc \
+    $$PWD/referenceindex.cc \
+    $$PWD/replay.cc \
+    $$PWD/shmring.cc \
+    $$PWD/wavfile.cc
+
+HEADERS += $$PWD/fifo.hh \
+    $$PWD/batch.hh \
+    $$PWD/clockestimator.hh \
+    $$PWD/dsp.hh \
+    $$PWD/lockin.hh \
+    $$PWD/lockingroup.hh \
+    $$PWD/lossless.hh \
+    $$PWD/measurelog.hh \
+    $$PWD/measureserver.hh \
+    $$PWD/phaseaverager.hh \
+    $$PWD/prefixsum.hh \
+    $$PWD/recorder.hh \
+    $$PWD/recording.hh \
+    $$PWD/referenceindex.hh \
+    $$PWD/replay.hh \
+    $$PWD/shmring.hh \
+    $$PWD/spscring.hh \
+    $$PWD/wavfile.hh
@@ -0,0 +1,94 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "envelope.hh"
+#include <QElapsedTimer>
+#include <cmath>
+
+void minMaxEnvelope(const qreal *x, int stride, int n, int samplesPerColumn,
+                    qreal t0, qreal dt, QList<QPointF> &out)
+{
+    samplesPerColumn = qMax(1, samplesPerColumn);
+
+    for (int first = 0; first < n; first += samplesPerColumn) {
+        const int last = qMin(n, first + samplesPerColumn);
+
+        // no branch into the loop, NAN fail both comparisons and are skipped
+        qreal lo = INFINITY;
+        qreal hi = -INFINITY;
+        for (int i = first; i < last; ++i) {
+            const qreal v = x[i * stride];
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+        }
+
+        if (lo <= hi) {
+            const qreal t = t0 + dt * qreal(first);
+            out << QPointF(t, lo) << QPointF(t, hi);
+        }
+    }
+}
+
+VumeterDecimator::VumeterDecimator(QObject *parent) :
+    QObject(parent)
+{
+}
+
+void VumeterDecimator::decimate(const VumeterBlock &block)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const int n = block.left_right.size();
+    Q_ASSERT(block.complex_exp.size() == n);
+
+    int trigger = 0;
+    for (int i = 0; i < n; ++i) {
+        if (!std::isnan(block.complex_exp[i].real()) && !std::isnan(block.complex_exp[i].imag())) {
+            trigger = i;
+            break;
+        }
+    }
+
+    VumeterEnvelope envelope;
+    const qreal t0 = -qreal(trigger) * block.msPerDot;
+
+    // QPair<qreal, qreal> and std::complex<qreal> are two contiguous qreal
+    static_assert(sizeof(QPair<qreal, qreal>) == 2 * sizeof(qreal), "QPair<qreal, qreal> is not packed");
+    const qreal *lr = reinterpret_cast<const qreal *>(block.left_right.constData());
+    minMaxEnvelope(lr, 2, n, block.samplesPerColumn, t0, block.msPerDot, envelope.left);
+    minMaxEnvelope(lr + 1, 2, n, block.samplesPerColumn, t0, block.msPerDot, envelope.right);
+
+    // the invalid reference samples are complex(NAN) = (NAN, 0) : the NAN is carried into the sine
+    // so that their columns stay empty
+    QVector<qreal> sin(n);
+    for (int i = 0; i < n; ++i) {
+        const std::complex<qreal> &z = block.complex_exp[i];
+        sin[i] = std::isnan(z.real()) ? qreal(NAN) : z.imag();
+    }
+    minMaxEnvelope(sin.constData(), 1, n, block.samplesPerColumn, t0, block.msPerDot, envelope.sin);
+
+    envelope.decimateNs = timer.nsecsElapsed();
+    emit ready(envelope);
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef ENVELOPE_HPP
+#define ENVELOPE_HPP
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QPair>
+#include <QPointF>
+#include <complex>
+
+/* Decimation of the vumeter
+ * Each pixel column of the graph receives the min and the max of its samples,
+ * the whole block is drawn with a number of points that depends only on the width of the graph
+ */
+
+// min/max of x[0], x[stride], ... x[(n-1)*stride] by columns of samplesPerColumn values, NAN are skipped
+// two points per column (t, min) (t, max) are appended to out, t = t0 + dt * first sample of the column
+void minMaxEnvelope(const qreal *x, int stride, int n, int samplesPerColumn,
+                    qreal t0, qreal dt, QList<QPointF> &out);
+
+// one block of the lockin to decimate
+struct VumeterBlock {
+    QVector<QPair<qreal, qreal>> left_right; // shared with Lockin::raw_signals(), no copy
+    QVector<std::complex<qreal>> complex_exp;
+    qreal msPerDot;
+    int samplesPerColumn;
+};
+Q_DECLARE_METATYPE(VumeterBlock)
+
+struct VumeterEnvelope {
+    QList<QPointF> left;
+    QList<QPointF> right;
+    QList<QPointF> sin;
+    qint64 decimateNs; // time spent into decimate()
+};
+Q_DECLARE_METATYPE(VumeterEnvelope)
+
+// lives into a worker thread
+class VumeterDecimator : public QObject {
+    Q_OBJECT
+public:
+    explicit VumeterDecimator(QObject *parent = 0);
+
+public slots:
+    // the time 0 is the first sample of the first complete chopper period (trigger)
+    void decimate(const VumeterBlock &block);
+
+signals:
+    void ready(const VumeterEnvelope &envelope);
+};
+
+#endif // ENVELOPE_HPP
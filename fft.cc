@@ -0,0 +1,160 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "fft.hh"
+#include <cmath>
+
+Fft::Fft(int n)
+{
+    setSize(n);
+}
+
+void Fft::setSize(int n)
+{
+    _n = qMax(1, n);
+
+    _twiddles.resize(_n);
+    for (int k = 0; k < _n; ++k)
+        _twiddles[k] = std::polar(qreal(1.0), -2.0 * M_PI * qreal(k) / qreal(_n));
+
+    // factors 4 first then 2, 3, 5, ...
+    _factors.clear();
+    int m = _n;
+    int p = 4;
+    while (m > 1) {
+        while (m % p != 0) {
+            if (p == 4)
+                p = 2;
+            else if (p == 2)
+                p = 3;
+            else
+                p += 2;
+            if (p * p > m)
+                p = m; // m is prime
+        }
+        m /= p;
+        _factors << p << m;
+    }
+    if (_factors.isEmpty())
+        _factors << 1 << 1;
+
+    int largest = 1;
+    for (int i = 0; i < _factors.size(); i += 2)
+        largest = qMax(largest, _factors[i]);
+    _scratch.resize(largest);
+}
+
+int Fft::size() const
+{
+    return _n;
+}
+
+void Fft::transform(const std::complex<qreal> *in, std::complex<qreal> *out) const
+{
+    if (_n == 1) {
+        out[0] = in[0];
+        return;
+    }
+    work(out, in, 1, _factors.constData());
+}
+
+void Fft::work(std::complex<qreal> *out, const std::complex<qreal> *in, int fstride, const int *factors) const
+{
+    const int p = factors[0];
+    const int m = factors[1];
+
+    // p sub transforms of size m, interleaved into in
+    if (m == 1) {
+        for (int q = 0; q < p; ++q)
+            out[q] = in[q * fstride];
+    } else {
+        for (int q = 0; q < p; ++q)
+            work(out + q * m, in + q * fstride, fstride * p, factors + 2);
+    }
+
+    switch (p) {
+    case 2:
+        butterfly2(out, fstride, m);
+        break;
+    case 4:
+        butterfly4(out, fstride, m);
+        break;
+    default:
+        butterflyGeneric(out, fstride, p, m);
+        break;
+    }
+}
+
+void Fft::butterfly2(std::complex<qreal> *out, int fstride, int m) const
+{
+    for (int k = 0; k < m; ++k) {
+        const std::complex<qreal> t = out[k + m] * _twiddles[k * fstride];
+        out[k + m] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+void Fft::butterfly4(std::complex<qreal> *out, int fstride, int m) const
+{
+    for (int k = 0; k < m; ++k) {
+        const std::complex<qreal> a0 = out[k];
+        const std::complex<qreal> a1 = out[k + m] * _twiddles[k * fstride];
+        const std::complex<qreal> a2 = out[k + 2 * m] * _twiddles[2 * k * fstride];
+        const std::complex<qreal> a3 = out[k + 3 * m] * _twiddles[3 * k * fstride];
+
+        const std::complex<qreal> s02 = a0 + a2;
+        const std::complex<qreal> d02 = a0 - a2;
+        const std::complex<qreal> s13 = a1 + a3;
+        // -i * (a1 - a3)
+        const std::complex<qreal> d13 = std::complex<qreal>((a1 - a3).imag(), -(a1 - a3).real());
+
+        out[k] = s02 + s13;
+        out[k + m] = d02 + d13;
+        out[k + 2 * m] = s02 - s13;
+        out[k + 3 * m] = d02 - d13;
+    }
+}
+
+void Fft::butterflyGeneric(std::complex<qreal> *out, int fstride, int p, int m) const
+{
+    std::complex<qreal> *scratch = _scratch.data();
+
+    for (int u = 0; u < m; ++u) {
+        for (int q = 0; q < p; ++q)
+            scratch[q] = out[u + q * m];
+
+        for (int q1 = 0; q1 < p; ++q1) {
+            const int k = u + q1 * m;
+            std::complex<qreal> x = scratch[0];
+            int t = 0;
+            for (int q = 1; q < p; ++q) {
+                t += fstride * k;
+                if (t >= _n)
+                    t %= _n;
+                x += scratch[q] * _twiddles[t];
+            }
+            out[k] = x;
+        }
+    }
+}
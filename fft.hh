@@ -0,0 +1,59 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <QVector>
+#include <complex>
+
+/* Forward complex FFT of any size, without external dependency
+ *
+ * Mixed-radix Cooley-Tukey : the size is factorized in 4, 2, 3, 5 and the other primes,
+ * radix 2 and 4 have their own butterflies, the other factors use the generic O(p^2) one.
+ * X[k] = sum x[j] exp(-2 pi i j k / n), not normalized.
+ */
+class Fft
+{
+public:
+    explicit Fft(int n = 1);
+    void setSize(int n);
+    int size() const;
+
+    // out of place, in and out of size()
+    void transform(const std::complex<qreal> *in, std::complex<qreal> *out) const;
+
+private:
+    void work(std::complex<qreal> *out, const std::complex<qreal> *in, int fstride, const int *factors) const;
+    void butterfly2(std::complex<qreal> *out, int fstride, int m) const;
+    void butterfly4(std::complex<qreal> *out, int fstride, int m) const;
+    void butterflyGeneric(std::complex<qreal> *out, int fstride, int p, int m) const;
+
+    int _n;
+    QVector<int> _factors; // p0, m0, p1, m1, ... with m(i) = p(i+1) * m(i+1)
+    QVector<std::complex<qreal>> _twiddles; // exp(-2 pi i k / n)
+    mutable QVector<std::complex<qreal>> _scratch;
+};
+
+#endif // FFT_HPP
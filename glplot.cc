@@ -0,0 +1,282 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "glplot.hh"
+#include <QOpenGLShaderProgram>
+#include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QDebug>
+#include <cmath>
+
+static const char *vertexShader =
+        "attribute highp vec2 position;\n"
+        "void main() {\n"
+        "    gl_Position = vec4(position, 0.0, 1.0);\n"
+        "}\n";
+
+static const char *fragmentShader =
+        "uniform lowp vec4 color;\n"
+        "void main() {\n"
+        "    gl_FragColor = color;\n"
+        "}\n";
+
+GlPlot::GlPlot(QWidget *parent) :
+    QOpenGLWidget(parent),
+    _program(nullptr),
+    _vbo(QOpenGLBuffer::VertexBuffer),
+    _colorLocation(-1)
+{
+    backgroundBrush = QBrush(Qt::black);
+    axesPen = QPen(Qt::lightGray);
+    subaxesPen = QPen(Qt::darkGray);
+    textPen = QPen(Qt::gray);
+    setZoom(-1.0, 1.0, -1.0, 1.0);
+}
+
+GlPlot::~GlPlot()
+{
+    makeCurrent();
+    _vbo.destroy();
+    delete _program;
+    doneCurrent();
+}
+
+void GlPlot::setZoom(qreal xmin, qreal xmax, qreal ymin, qreal ymax)
+{
+    _xmin = xmin;
+    _xmax = xmax > xmin ? xmax : xmin + 1.0;
+    _ymin = ymin;
+    _ymax = ymax > ymin ? ymax : ymin + 1.0;
+    update();
+}
+
+qreal GlPlot::xmin() const
+{
+    return _xmin;
+}
+
+qreal GlPlot::xmax() const
+{
+    return _xmax;
+}
+
+qreal GlPlot::xwidth() const
+{
+    return _xmax - _xmin;
+}
+
+qreal GlPlot::ymin() const
+{
+    return _ymin;
+}
+
+qreal GlPlot::ymax() const
+{
+    return _ymax;
+}
+
+void GlPlot::setxmax(qreal xmax)
+{
+    setZoom(xmax - xwidth(), xmax, _ymin, _ymax);
+}
+
+void GlPlot::fit()
+{
+    qreal x0 = INFINITY, x1 = -INFINITY, y0 = INFINITY, y1 = -INFINITY;
+    foreach (const XY::PointList *list, pointLists) {
+        for (int i = 0; i < list->size(); ++i) {
+            const QPointF &p = list->at(i);
+            if (std::isnan(p.x()) || std::isnan(p.y()))
+                continue;
+            x0 = qMin(x0, p.x());
+            x1 = qMax(x1, p.x());
+            y0 = qMin(y0, p.y());
+            y1 = qMax(y1, p.y());
+        }
+    }
+    if (x0 > x1)
+        return;
+
+    const qreal margin = 0.05 * qMax(y1 - y0, 1e-12);
+    setZoom(x0, x1, y0 - margin, y1 + margin);
+}
+
+void GlPlot::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    _program = new QOpenGLShaderProgram(this);
+    _program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    _program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    _program->bindAttributeLocation("position", 0);
+    if (!_program->link()) {
+        qDebug() << __FUNCTION__ << ": cannot link the shaders" << _program->log();
+    }
+    _colorLocation = _program->uniformLocation("color");
+
+    _vbo.create();
+    _vbo.setUsagePattern(QOpenGLBuffer::StreamDraw);
+}
+
+// 1, 2 or 5 times a power of ten, about 8 ticks into width
+qreal GlPlot::tickStep(qreal width)
+{
+    if (!(width > 0.0))
+        return 1.0;
+
+    const qreal raw = width / 8.0;
+    const qreal p = std::pow(10.0, std::floor(std::log10(raw)));
+    const qreal m = raw / p;
+    return (m < 1.5 ? 1.0 : m < 3.5 ? 2.0 : m < 7.5 ? 5.0 : 10.0) * p;
+}
+
+void GlPlot::addLine(qreal x0, qreal y0, qreal x1, qreal y1)
+{
+    const qreal sx = 2.0 / (_xmax - _xmin);
+    const qreal sy = 2.0 / (_ymax - _ymin);
+    _vertices << GLfloat((x0 - _xmin) * sx - 1.0) << GLfloat((y0 - _ymin) * sy - 1.0)
+              << GLfloat((x1 - _xmin) * sx - 1.0) << GLfloat((y1 - _ymin) * sy - 1.0);
+}
+
+void GlPlot::addBatch(GLenum mode, int first, const QPen &pen)
+{
+    Batch batch;
+    batch.mode = mode;
+    batch.first = first;
+    batch.count = _vertices.size() / 2 - first;
+    batch.color = pen.color();
+    batch.width = GLfloat(qMax(qreal(1.0), pen.widthF()) * devicePixelRatio());
+    if (batch.count > 0)
+        _batches << batch;
+}
+
+void GlPlot::paintGL()
+{
+    _vertices.clear();
+    _batches.clear();
+
+    const qreal xstep = tickStep(_xmax - _xmin);
+    const qreal ystep = tickStep(_ymax - _ymin);
+    const qint64 xfirst = qint64(std::ceil(_xmin / xstep));
+    const qint64 yfirst = qint64(std::ceil(_ymin / ystep));
+
+    // grid and axes
+    int first = 0;
+    for (qint64 i = xfirst; i * xstep <= _xmax; ++i)
+        addLine(i * xstep, _ymin, i * xstep, _ymax);
+    for (qint64 i = yfirst; i * ystep <= _ymax; ++i)
+        addLine(_xmin, i * ystep, _xmax, i * ystep);
+    addBatch(GL_LINES, first, subaxesPen);
+
+    first = _vertices.size() / 2;
+    addLine(_xmin, 0.0, _xmax, 0.0);
+    addLine(0.0, _ymin, 0.0, _ymax);
+    addBatch(GL_LINES, first, axesPen);
+
+    // curves, in double until the conversion to NDC
+    const qreal sx = 2.0 / (_xmax - _xmin);
+    const qreal sy = 2.0 / (_ymax - _ymin);
+    foreach (const XY::PointList *list, pointLists) {
+        first = _vertices.size() / 2;
+        for (int i = 0; i < list->size(); ++i) {
+            const QPointF &p = list->at(i);
+            if (std::isnan(p.x()) || std::isnan(p.y()))
+                continue;
+            _vertices << GLfloat((p.x() - _xmin) * sx - 1.0) << GLfloat((p.y() - _ymin) * sy - 1.0);
+        }
+        addBatch(GL_LINE_STRIP, first, list->linePen);
+    }
+
+    const QColor background = backgroundBrush.color();
+    glClearColor(background.redF(), background.greenF(), background.blueF(), 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!_batches.isEmpty() && _program->isLinked()) {
+        _program->bind();
+        _vbo.bind();
+        _vbo.allocate(_vertices.constData(), _vertices.size() * int(sizeof(GLfloat)));
+        _program->enableAttributeArray(0);
+        _program->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+
+        foreach (const Batch &batch, _batches) {
+            _program->setUniformValue(_colorLocation, batch.color);
+            glLineWidth(batch.width);
+            glDrawArrays(batch.mode, batch.first, batch.count);
+        }
+
+        _program->disableAttributeArray(0);
+        _vbo.release();
+        _program->release();
+    }
+
+    // the labels are drawn by QPainter over the GL content
+    QPainter painter(this);
+    painter.setPen(textPen);
+    for (qint64 i = xfirst; i * xstep <= _xmax; ++i) {
+        const qreal px = (i * xstep - _xmin) / (_xmax - _xmin) * width();
+        painter.drawText(QPointF(px + 2.0, height() - 2.0), QString::number(i * xstep));
+    }
+    for (qint64 i = yfirst; i * ystep <= _ymax; ++i) {
+        const qreal py = (_ymax - i * ystep) / (_ymax - _ymin) * height();
+        painter.drawText(QPointF(2.0, py - 2.0), QString::number(i * ystep));
+    }
+}
+
+void GlPlot::wheelEvent(QWheelEvent *event)
+{
+    const qreal factor = std::pow(0.8, event->angleDelta().y() / 120.0);
+
+    if (event->modifiers() & Qt::ShiftModifier) {
+        const qreal y = _ymax - qreal(event->pos().y()) / height() * (_ymax - _ymin);
+        setZoom(_xmin, _xmax, y - (y - _ymin) * factor, y + (_ymax - y) * factor);
+    } else {
+        const qreal x = _xmin + qreal(event->pos().x()) / width() * (_xmax - _xmin);
+        setZoom(x - (x - _xmin) * factor, x + (_xmax - x) * factor, _ymin, _ymax);
+    }
+    event->accept();
+}
+
+void GlPlot::mousePressEvent(QMouseEvent *event)
+{
+    _lastMouse = event->pos();
+}
+
+void GlPlot::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton))
+        return;
+
+    const QPoint d = event->pos() - _lastMouse;
+    _lastMouse = event->pos();
+
+    const qreal dx = qreal(d.x()) / width() * (_xmax - _xmin);
+    const qreal dy = qreal(d.y()) / height() * (_ymax - _ymin);
+    setZoom(_xmin - dx, _xmax - dx, _ymin + dy, _ymax + dy);
+}
+
+void GlPlot::mouseDoubleClickEvent(QMouseEvent *)
+{
+    fit();
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef GLPLOT_HPP
+#define GLPLOT_HPP
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include <QVector>
+#include <QList>
+#include <QBrush>
+#include <QPen>
+#include "xygraph/xygraph.hh"
+
+class QOpenGLShaderProgram;
+
+/* Same role as XY::Graph but the curves are drawn by the GPU
+ *
+ * All the points (NDC coordinates, computed in double on the CPU) are uploaded into one
+ * vertex buffer per frame and drawn as line strips by a GLSL 1.00 program :
+ * it runs on OpenGL 2.1, OpenGL ES 2 and Mesa's llvmpipe.
+ * The lines are solid (the dash of the pens is ignored), the dots are not drawn.
+ *
+ * Wheel : zoom on x (on y with Shift), drag : move, double click : fit the curves
+ */
+class GlPlot : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+public:
+    explicit GlPlot(QWidget *parent = 0);
+    ~GlPlot();
+
+    QList<XY::PointList *> pointLists; // not owned
+    QBrush backgroundBrush;
+    QPen axesPen;
+    QPen subaxesPen;
+    QPen textPen;
+
+    void setZoom(qreal xmin, qreal xmax, qreal ymin, qreal ymax);
+    qreal xmin() const;
+    qreal xmax() const;
+    qreal xwidth() const;
+    qreal ymin() const;
+    qreal ymax() const;
+    void setxmax(qreal xmax); // keep the width
+    void fit();
+
+protected:
+    void initializeGL() override;
+    void paintGL() override;
+
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    struct Batch {
+        GLenum mode;
+        int first; // vertex
+        int count;
+        QColor color;
+        float width;
+    };
+
+    void addLine(qreal x0, qreal y0, qreal x1, qreal y1);
+    void addBatch(GLenum mode, int first, const QPen &pen);
+    static qreal tickStep(qreal width);
+
+    QOpenGLShaderProgram *_program;
+    QOpenGLBuffer _vbo;
+    int _colorLocation;
+
+    QVector<GLfloat> _vertices; // x, y in NDC
+    QVector<Batch> _batches;
+
+    qreal _xmin, _xmax, _ymin, _ymax;
+    QPoint _lastMouse;
+};
+
+#endif // GLPLOT_HPP
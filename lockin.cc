@@ -22,31 +22,54 @@
 
 #include "lockin.hh"
 #include "fifo.hh"
+#include "dsp.hh"
+#include "recorder.hh"
+#include "shmring.hh"
 #include <cmath>
 #include <QDebug>
-#include <QDataStream>
+#include <QElapsedTimer>
+#include <chrono>
+#include <limits>
+
+// difference between the device clock and the received samples considered as a gap
+static const qreal gapTolerance = 0.010; // [s]
+// same from the arrival times, larger : it includes the jitter of the delivery latency
+static const qreal arrivalTolerance = 0.050; // [s]
 
 Lockin::Lockin(QObject *parent) :
     QObject(parent)
 {
+    qRegisterMetaType<LockinMeasure>();
+
     _fifo = new Fifo(this);
     _fifo->open(QIODevice::ReadWrite);
 
     _audioInput = nullptr;
+    _recorder = nullptr;
+    _shm = nullptr;
+    _offline = false;
+    _notifyInterval = 500;
 
     _invertLR = false;
+    _systemClock = false;
     setIntegrationTime(3.0);
+    _historyLength = 300.0;
+    _sampleIndex = 0;
+    _firstSample = 0;
+
+    resetStats();
 }
 
 Lockin::~Lockin()
 {
     if (isRunning())
         stop();
+    stopSharedMemory();
 }
 
 bool Lockin::isRunning() const
 {
-    return _audioInput != nullptr;
+    return _audioInput != nullptr || _offline;
 }
 
 bool Lockin::isFormatSupported(const QAudioFormat &format)
@@ -64,7 +87,57 @@ bool Lockin::isFormatSupported(const QAudioFormat &format)
 
 bool Lockin::start(const QAudioDeviceInfo &audioDevice, const QAudioFormat &format, int output_period)
 {
-    if (_audioInput != 0) {
+    if (!prepare(format)) {
+        return false;
+    }
+
+    _audioInput = new QAudioInput(audioDevice, format, this);
+    _audioInput->setNotifyInterval(output_period);
+    _notifyInterval = output_period;
+
+    connect(_audioInput, SIGNAL(notify()), this, SLOT(interpretInput()));
+
+    _audioInput->start(_fifo);
+
+    return true;
+}
+
+bool Lockin::startOffline(const QAudioFormat &format, qint64 firstSample)
+{
+    if (!prepare(format, firstSample)) {
+        return false;
+    }
+
+    _offline = true;
+
+    return true;
+}
+
+void Lockin::feed(const QByteArray &data)
+{
+    if (!_offline) {
+        qDebug() << __FUNCTION__ << ": lockin is not started offline";
+        return;
+    }
+
+    _stats.fifoBytes.store(data.size(), std::memory_order_relaxed);
+    processBlock(data);
+}
+
+void Lockin::feed(const QByteArray &data, const QVector<std::complex<qreal> > &reference)
+{
+    if (!_offline) {
+        qDebug() << __FUNCTION__ << ": lockin is not started offline";
+        return;
+    }
+
+    _stats.fifoBytes.store(data.size(), std::memory_order_relaxed);
+    processBlock(data, &reference);
+}
+
+bool Lockin::prepare(const QAudioFormat &format, qint64 firstSample)
+{
+    if (isRunning()) {
         qDebug() << __FUNCTION__ << ": lockin is already running, please stop is before start";
         return false;
     }
@@ -79,37 +152,159 @@ bool Lockin::start(const QAudioDeviceInfo &audioDevice, const QAudioFormat &form
         return false;
     }
 
-    _audioInput = new QAudioInput(audioDevice, format, this);
-    _audioInput->setNotifyInterval(output_period);
-
-    connect(_audioInput, SIGNAL(notify()), this, SLOT(interpretInput()));
-
-    // pour être au millieu avec le temps
-    _timeValue = 0;
+    _sampleIndex = firstSample;
+    _firstSample = firstSample;
+    _referencePeriods = 0;
+    _referenceSamples = 0;
+    _clock.reset(format.sampleRate());
+    _lastGap = -1;
+    _lastOverrun = -1;
+    _late = false;
 
-    // nombre d'échantillons pour le temps d'integration
-    _sampleIntegration = format.sampleRate() * _integrationTime;
+    _format = format;
 
     // nettoyage des variables
     _fifo->readAll(); // vide le fifo
-    _measures.clear(); // vide <x,y>
+    // historique des sommes, par paquets de 0.5 ms
+    _integrator.reset(firstSample, qMax(1, format.sampleRate() / 2000), 0);
+    updateIntegration();
+    _phaseAverager.reset(_phaseAverager.bins());
 
-    _format = format;
-
-    _audioInput->start(_fifo);
+    resetStats();
 
     return true;
 }
 
+// number of samples of each integration window, the history is enlarged in place if needed
+void Lockin::updateIntegration()
+{
+    const int rate = _format.sampleRate();
+
+    _sampleIntegrations.clear();
+    qreal longest = 0.0;
+    for (int i = 0; i < _integrationTimes.size(); ++i) {
+        _sampleIntegrations << qMax(qint64(1), qint64(rate * _integrationTimes[i]));
+        longest = qMax(longest, _integrationTimes[i]);
+    }
+
+    const qint64 capacity = qint64(qMax(_historyLength, 2.0 * longest) * rate) / _integrator.bucket() + 2;
+    if (capacity > _integrator.capacity())
+        _integrator.setCapacity(capacity);
+}
+
+void Lockin::setOutputPeriod(qreal outputPeriod)
+{
+    _notifyInterval = qMax(1, qRound(1000.0 * outputPeriod));
+
+    // the next notify of the device comes after the new interval
+    if (_audioInput)
+        _audioInput->setNotifyInterval(_notifyInterval);
+}
+
+qreal Lockin::outputPeriod() const
+{
+    return qreal(_notifyInterval) / 1000.0;
+}
+
 void Lockin::setIntegrationTime(qreal integrationTime)
 {
-    Q_ASSERT(_audioInput == 0);
-    _integrationTime = integrationTime;
+    if (integrationTime > maxIntegrationTime) {
+        qDebug() << __FUNCTION__ << ":" << integrationTime << "s clamped to" << maxIntegrationTime;
+        integrationTime = maxIntegrationTime;
+    }
+
+    if (_integrationTimes.isEmpty())
+        _integrationTimes << integrationTime;
+    else
+        _integrationTimes[0] = integrationTime;
+
+    if (isRunning())
+        updateIntegration();
 }
 
 qreal Lockin::integrationTime() const
 {
-    return _integrationTime;
+    return _integrationTimes[0];
+}
+
+void Lockin::setExtraIntegrationTimes(const QVector<qreal> &integrationTimes)
+{
+    _integrationTimes.resize(1);
+    foreach (qreal t, integrationTimes) {
+        if (t > maxIntegrationTime)
+            qDebug() << __FUNCTION__ << ":" << t << "s clamped to" << maxIntegrationTime;
+        _integrationTimes << qMin(t, maxIntegrationTime);
+    }
+
+    if (isRunning())
+        updateIntegration();
+}
+
+const QVector<qreal> &Lockin::integrationTimes() const
+{
+    return _integrationTimes;
+}
+
+int Lockin::channelCount() const
+{
+    return _integrationTimes.size();
+}
+
+void Lockin::setHistoryLength(qreal seconds)
+{
+    _historyLength = seconds;
+
+    if (isRunning())
+        updateIntegration();
+}
+
+qreal Lockin::historyLength() const
+{
+    return _historyLength;
+}
+
+void Lockin::setPhaseBins(int bins)
+{
+    _phaseAverager.reset(bins);
+}
+
+void Lockin::setPhaseTimeConstant(qreal seconds)
+{
+    _phaseAverager.setTimeConstant(seconds);
+}
+
+const PhaseAverager &Lockin::phaseAverager() const
+{
+    return _phaseAverager;
+}
+
+const PrefixSum &Lockin::integrator() const
+{
+    return _integrator;
+}
+
+void Lockin::setSystemClockTimestamps(bool on)
+{
+    Q_ASSERT(!isRunning());
+    _systemClock = on;
+}
+
+const ClockEstimator &Lockin::clock() const
+{
+    return _clock;
+}
+
+qreal Lockin::timeAt(qint64 systemNs) const
+{
+    if (!_systemClock || !_clock.hasAnchor())
+        return NAN;
+    return _clock.toSample(systemNs) / qreal(_format.sampleRate());
+}
+
+qint64 Lockin::monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void Lockin::setInvertLR(bool on)
@@ -132,15 +327,143 @@ const QAudioFormat &Lockin::format() const
     return _format;
 }
 
+void Lockin::resetStats()
+{
+    for (int i = 0; i < LockinStats::StageCount; ++i) {
+        _stats.lastNs[i] = 0;
+        _stats.totalNs[i] = 0;
+    }
+    _stats.blocks = 0;
+    _stats.samples = 0;
+    _stats.nanSamples = 0;
+    _stats.fifoBytes = 0;
+    _stats.integratorDepth = 0;
+    _stats.gaps = 0;
+    _stats.droppedSamples = 0;
+    _stats.lateBlocks = 0;
+    _stats.overruns = 0;
+    _stats.recorderQueue = 0;
+    _stats.recorderDropped = 0;
+    _stats.recorderError = false;
+    _stats.clockPpb = std::numeric_limits<qint64>::min();
+}
+
+LockinStats Lockin::stats() const
+{
+    LockinStats s;
+    for (int i = 0; i < LockinStats::StageCount; ++i) {
+        s.lastNs[i] = _stats.lastNs[i].load(std::memory_order_relaxed);
+        s.totalNs[i] = _stats.totalNs[i].load(std::memory_order_relaxed);
+    }
+    s.blocks = _stats.blocks.load(std::memory_order_relaxed);
+    s.samples = _stats.samples.load(std::memory_order_relaxed);
+    s.nanSamples = _stats.nanSamples.load(std::memory_order_relaxed);
+    s.fifoBytes = _stats.fifoBytes.load(std::memory_order_relaxed);
+    s.integratorDepth = _stats.integratorDepth.load(std::memory_order_relaxed);
+    s.gaps = _stats.gaps.load(std::memory_order_relaxed);
+    s.droppedSamples = _stats.droppedSamples.load(std::memory_order_relaxed);
+    s.lateBlocks = _stats.lateBlocks.load(std::memory_order_relaxed);
+    s.overruns = _stats.overruns.load(std::memory_order_relaxed);
+    s.recorderQueue = _stats.recorderQueue.load(std::memory_order_relaxed);
+    s.recorderDropped = _stats.recorderDropped.load(std::memory_order_relaxed);
+    s.recorderError = _stats.recorderError.load(std::memory_order_relaxed);
+    const qint64 ppb = _stats.clockPpb.load(std::memory_order_relaxed);
+    s.clockPpm = ppb == std::numeric_limits<qint64>::min() ? NAN : qreal(ppb) * 1e-3;
+    return s;
+}
+
+const char *LockinStats::stageName(int stage)
+{
+    switch (stage) {
+    case Decode: return "decode";
+    case Reference: return "reference";
+    case Mix: return "mixer";
+    case Integrate: return "integrator";
+    }
+    return "";
+}
+
+qreal Lockin::referenceFrequency() const
+{
+    if (_referenceSamples == 0)
+        return 0.0;
+    return qreal(_format.sampleRate()) * qreal(_referencePeriods) / qreal(_referenceSamples);
+}
+
 void Lockin::stop()
 {
     if (_audioInput != nullptr) {
         _audioInput->stop();
         delete _audioInput;
         _audioInput = nullptr;
+    } else if (_offline) {
+        _offline = false;
     } else {
         qDebug() << __FUNCTION__ << ": lockin is not running";
     }
+
+    stopRecording();
+}
+
+bool Lockin::startRecording(const QString &path)
+{
+    if (!isRunning()) {
+        qDebug() << __FUNCTION__ << ": lockin is not running";
+        return false;
+    }
+
+    stopRecording();
+
+    _recorder = new Recorder(this);
+    if (!_recorder->open(path, _format)) {
+        delete _recorder;
+        _recorder = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void Lockin::stopRecording()
+{
+    if (_recorder != nullptr) {
+        _recorder->close();
+        // the last chunk, the index or the header may fail too
+        _stats.recorderError.store(_recorder->hasWriteError(), std::memory_order_relaxed);
+        delete _recorder;
+        _recorder = nullptr;
+    }
+}
+
+bool Lockin::isRecording() const
+{
+    return _recorder != nullptr;
+}
+
+bool Lockin::startSharedMemory(const QString &name, int capacity)
+{
+    stopSharedMemory();
+
+    _shm = new ShmRingWriter;
+    if (!_shm->open(name.toStdString(), quint64(qMax(2, capacity)))) {
+        qDebug() << __FUNCTION__ << ": cannot share" << name;
+        delete _shm;
+        _shm = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void Lockin::stopSharedMemory()
+{
+    delete _shm;
+    _shm = nullptr;
+}
+
+bool Lockin::isSharingMemory() const
+{
+    return _shm != nullptr;
 }
 
 void Lockin::interpretInput()
@@ -158,215 +481,235 @@ void Lockin::interpretInput()
      * 1.0s 500Hz -> 0.4%
      */
 
-    _left_right.clear();
-
-    // load audio channels and cast them in the interval (-1, 1)
-    readSoudCard();
+    _stats.fifoBytes.store(_fifo->bytesAvailable(), std::memory_order_relaxed);
+    checkDeviceClock(_fifo->bytesAvailable());
+    processBlock(_fifo->readAll());
+}
 
-    if (_left_right.empty()) {
-        qDebug() << __FUNCTION__ << ": empty channels";
-        return;
+/* Samples lost before reaching the fifo (xrun) are detected in two ways :
+ * - processedUSecs, only where the backend counts the samples at the device ;
+ *   with ALSA and PulseAudio Qt computes it from the bytes delivered, it never shows a gap
+ * - the arrival time : the steady clock mapped on the sample index by _clock (true rate of the device)
+ *   tells how many samples should have arrived, a block that comes with too few samples may be after a gap
+ * A gap counted by the device moves the time base forward and the outputs integrating over it are flagged.
+ * A late block alone can also be a scheduling or PulseAudio latency without any loss :
+ * the outputs are flagged but neither the time base nor the recording are moved
+ * If too much data is waiting in the fifo we did not read it in time (overrun)
+ */
+void Lockin::checkDeviceClock(qint64 bytes)
+{
+    const qint64 rate = _format.sampleRate();
+    const qint64 frames = bytes / _format.bytesPerFrame();
+    const qint64 now = monotonicNs();
+
+    qint64 deviceSamples = qint64(_audioInput->processedUSecs()) * rate / 1000000;
+    qint64 gap = deviceSamples - (_sampleIndex + frames);
+
+    if (gap > qint64(gapTolerance * rate)) {
+        qDebug() << __FUNCTION__ << ":" << gap << "samples lost";
+        _stats.gaps.fetch_add(1, std::memory_order_relaxed);
+        _stats.droppedSamples.fetch_add(gap, std::memory_order_relaxed);
+
+        // resynchronize the time base on the device
+        _sampleIndex += gap;
+        _integrator.skip(gap);
+        if (_recorder)
+            _recorder->pushSilence(gap);
+        _lastGap = _sampleIndex;
     }
 
-    qreal delta_t = qreal(_left_right.size()) / qreal(_format.sampleRate());
-    _timeValue += delta_t;
-
-	parseChopperSignal();
-    emit newRawData();
+    // only once the rate is fitted : the first blocks come in bursts while the device starts
+    // a lateness that lasts is counted once, until the fit absorbs it
+    bool late = false;
+    if (_clock.isValid()) {
+        const qint64 behind = qint64(_clock.toSample(now)) - (_sampleIndex + frames);
+        late = behind > qint64(arrivalTolerance * rate);
+        if (late && !_late) {
+            qDebug() << __FUNCTION__ << ":" << behind << "samples late";
+            _stats.lateBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (late)
+            _lastGap = _sampleIndex + frames;
+    }
+    _late = late;
 
-    for (int i = 0; i < _left_right.size(); ++i) {
-        std::complex<qreal> x = _complex_exp[i] * _left_right[i].first;
+    if (frames > 2 * _notifyInterval * rate / 1000) {
+        _stats.overruns.fetch_add(1, std::memory_order_relaxed);
+        _lastOverrun = _sampleIndex + frames;
+    }
 
-        if (!std::isnan(x.real()) && !std::isnan(x.imag())) {
-            _measures << x;
-        }
+    // the last sample of the block has just arrived, a device gap is already added to the index
+    if (frames > 0) {
+        _clock.observe(_sampleIndex + frames, now);
+        if (_clock.isValid())
+            _stats.clockPpb.store(qint64(_clock.ppm() * 1e3), std::memory_order_relaxed);
     }
+}
 
-    // stop if there is not enough values into data xy
-    if (_measures.size() < _sampleIntegration) {
-        return;
+void Lockin::processBlock(const QByteArray &data, const QVector<std::complex<qreal>> *reference)
+{
+    QElapsedTimer timer;
+    timer.start();
+    qint64 lap = 0;
+    auto record = [&](int stage) {
+        qint64 now = timer.nsecsElapsed();
+        _stats.lastNs[stage].store(now - lap, std::memory_order_relaxed);
+        _stats.totalNs[stage].fetch_add(now - lap, std::memory_order_relaxed);
+        lap = now;
+    };
+
+    if (_recorder) {
+        _recorder->push(data);
+        _stats.recorderQueue.store(_recorder->queuedBytes(), std::memory_order_relaxed);
+        _stats.recorderDropped.store(_recorder->droppedBytes(), std::memory_order_relaxed);
+        _stats.recorderError.store(_recorder->hasWriteError(), std::memory_order_relaxed);
     }
 
-    // remove the old unneeded values
-    while (_measures.size() > _sampleIntegration)
-        _measures.removeFirst();
+    _left_right.clear();
 
-    std::complex<qreal> x = 0.0;
+    // load audio channels and cast them in the interval (-1, 1)
+    readSoudCard(data);
+    record(LockinStats::Decode);
 
-    for (int i = 0; i < _measures.size(); ++i) {
-        x += _measures[i];
+    if (_left_right.empty()) {
+        qDebug() << __FUNCTION__ << ": empty channels";
+        return;
     }
 
-    x /= qreal(_sampleIntegration);
+    _stats.blocks.fetch_add(1, std::memory_order_relaxed);
+    _stats.samples.fetch_add(_left_right.size(), std::memory_order_relaxed);
 
-    emit newValue(_timeValue, std::abs(x));
-}
+    _sampleIndex += _left_right.size();
 
-void Lockin::readSoudCard()
-{
-    qreal middle = 0;
-
-    switch (_format.sampleSize()) {
-    case 8:
-        middle = 128;
-        Q_ASSERT(_fifo->bytesAvailable() % 2 == 0);
-        break;
-    case 16:
-        middle = 32768;
-        Q_ASSERT((_fifo->bytesAvailable() / 2) % 2 == 0);
-        break;
-    case 32:
-        middle = 2147483648;
-        Q_ASSERT((_fifo->bytesAvailable() / 4) % 2 == 0);
-        break;
+    int periods = 0;
+    if (reference) {
+        Q_ASSERT(reference->size() == _left_right.size());
+        _complex_exp = *reference;
+    } else {
+        periods = parseChopperSignal();
     }
+    record(LockinStats::Reference);
 
-    QDataStream in(_fifo);
-    in.setByteOrder(QDataStream::ByteOrder(_format.byteOrder()));
-
-    float _float;
-    qint8 _int8;
-    qint16 _int16;
-    qint32 _int32;
-    quint8 _uint8;
-    quint16 _uint16;
-    quint32 _uint32;
-    QPair<qreal,qreal> pair;
+    emit newRawData();
+    lap = timer.nsecsElapsed(); // the slots connected to newRawData are not part of the lockin
 
-    switch (_format.sampleType()) {
-    case QAudioFormat::Float:
-        while (!in.atEnd()) {
-            in >> _float;
-            pair.first = _float;
-            in >> _float;
-            pair.second = _float;
-            if (_invertLR) {
-                std::swap(pair.first, pair.second);
-            }
-            _left_right.append(pair);
-        }
-        break;
-    case QAudioFormat::SignedInt:
-        switch (_format.sampleSize()) {
-        case 8:
-            while (!in.atEnd()) {
-                in >> _int8;
-                pair.first = qreal(_int8) / middle;
-                in >> _int8;
-                pair.second = qreal(_int8) / middle;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
-        case 16:
-            while (!in.atEnd()) {
-                in >> _int16;
-                pair.first = qreal(_int16) / middle;
-                in >> _int16;
-                pair.second = qreal(_int16) / middle;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
-        case 32:
-            while (!in.atEnd()) {
-                in >> _int32;
-                pair.first = qreal(_int32) / middle;
-                in >> _int32;
-                pair.second = qreal(_int32) / middle;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
+    int valid = mixSignal(_left_right, _complex_exp, _mixed);
+    _stats.nanSamples.fetch_add(_left_right.size() - valid, std::memory_order_relaxed);
+    if (periods > 0) {
+        _referencePeriods += periods;
+        _referenceSamples += valid - 1; // the first valid value is the empty period
+    }
+    _phaseAverager.add(_left_right, _complex_exp, qreal(_left_right.size()) / _format.sampleRate());
+    record(LockinStats::Mix);
+
+    _integrator.append(_mixed.constData(), _mixed.size());
+
+    // one output per channel with a complete integration window
+    _outputs.clear();
+    for (int c = 0; c < _sampleIntegrations.size(); ++c) {
+        const qint64 length = _sampleIntegrations[c];
+        std::complex<qreal> x;
+        qint64 count;
+        if (_sampleIndex - _firstSample < length
+                || !_integrator.mean(_sampleIndex, length, &x, &count)) {
+            continue;
         }
-        break;
-    case QAudioFormat::UnSignedInt:
-        switch (_format.sampleSize()) {
-        case 8:
-            while (!in.atEnd()) {
-                in >> _uint8;
-                pair.first = (qreal(_uint8) / middle) - 1.0;
-                in >> _uint8;
-                pair.second = (qreal(_uint8) / middle) - 1.0;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
-        case 16:
-            while (!in.atEnd()) {
-                in >> _uint16;
-                pair.first = (qreal(_uint16) / middle) - 1.0;
-                in >> _uint16;
-                pair.second = (qreal(_uint16) / middle) - 1.0;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
-        case 32:
-            while (!in.atEnd()) {
-                in >> _uint32;
-                pair.first = (qreal(_uint32) / middle) - 1.0;
-                in >> _uint32;
-                pair.second = (qreal(_uint32) / middle) - 1.0;
-                if (_invertLR) {
-                    std::swap(pair.first, pair.second);
-                }
-                _left_right.append(pair);
-            }
-            break;
+        if (c == 0)
+            _stats.integratorDepth.store(count, std::memory_order_relaxed);
+
+        LockinMeasure measure = stamp(_sampleIndex - length, _sampleIndex, x);
+        measure.channel = c;
+        if (_lastGap >= 0 && _sampleIndex - length < _lastGap)
+            measure.flags |= LockinMeasure::Gap;
+        if (_lastOverrun >= 0 && _sampleIndex - length < _lastOverrun)
+            measure.flags |= LockinMeasure::Overrun;
+        _outputs << measure;
+    }
+    record(LockinStats::Integrate);
+
+    // the shared memory first : its readers do not wait for the slots
+    if (_shm) {
+        for (int i = 0; i < _outputs.size(); ++i) {
+            const LockinMeasure &m = _outputs[i];
+            ShmRingRecord r;
+            r.sequence = 0; // set by write()
+            r.sampleIndex = m.sampleIndex;
+            r.time = m.time;
+            r.x = m.value.real();
+            r.y = m.value.imag();
+            r.systemTimeNs = m.systemTimeNs;
+            r.flags = m.flags;
+            r.channel = quint32(m.channel);
+            _shm->write(r);
         }
-        break;
-    case QAudioFormat::Unknown:
-        break;
+    }
+
+    for (int i = 0; i < _outputs.size(); ++i) {
+        if (_outputs[i].channel == 0)
+            emit newValue(_outputs[i].time, std::abs(_outputs[i].value));
+        emit newMeasure(_outputs[i]);
     }
 }
 
-void Lockin::parseChopperSignal()
+// output for the window [from, to), stamped at its center
+LockinMeasure Lockin::stamp(qint64 from, qint64 to, std::complex<qreal> value) const
 {
-    _complex_exp.clear();
-
-    int i = 0;
-
-    // set the first value as ignored
-    _complex_exp << NAN;
-    i++;
-
-    for (; i < _left_right.size(); ++i) {
-        if (_left_right[i-1].second < 0.0 && _left_right[i].second >= 0.0) {
-            // first rising edge
-            break;
-        }
-        _complex_exp << NAN;
+    const qint64 rate = _format.sampleRate();
+
+    LockinMeasure measure;
+    measure.channel = 0;
+    measure.sampleIndex = (from + to - 1) / 2;
+    measure.time = qreal(from + to - 1) / qreal(2 * rate);
+    measure.systemTimeNs = 0;
+    if (_systemClock && _clock.hasAnchor()) {
+        measure.systemTimeNs = _clock.toNs(qreal(from + to - 1) * 0.5);
     }
+    measure.value = value;
+    measure.flags = 0;
+    return measure;
+}
 
-    int periodSize = 0;
-    for (; i < _left_right.size(); ++i) {
-        periodSize++;
-        if (_left_right[i-1].second < 0.0 && _left_right[i].second >= 0.0) {
-            // rising edge
+bool Lockin::average(qint64 end, qreal integrationTime, LockinMeasure *measure) const
+{
+    const qint64 length = qMax(qint64(1), qint64(integrationTime * _format.sampleRate()));
+    std::complex<qreal> x;
+    if (!_integrator.mean(end, length, &x))
+        return false;
 
-            for (int j = 0; j < periodSize; ++j) {
-                qreal angle = 2.0 * M_PI * qreal(j) / qreal(periodSize);
-                _complex_exp << std::exp(std::complex<qreal>(0.0, 1.0) * angle);
-            }
+    *measure = stamp(end - length, end, x);
+    return true;
+}
 
-            periodSize = 0;
-        }
+QVector<LockinMeasure> Lockin::history(qreal integrationTime, qreal outputPeriod) const
+{
+    QVector<LockinMeasure> measures;
+    if (_format.sampleRate() <= 0)
+        return measures;
+
+    const qint64 length = qMax(qint64(1), qint64(integrationTime * _format.sampleRate()));
+    const qint64 period = qMax(qint64(1), qint64(outputPeriod * _format.sampleRate()));
+    const qint64 first = qMax(_integrator.begin(), _firstSample) + length;
+
+    // aligned on the last sample
+    qint64 end = _integrator.end();
+    if (end < first)
+        return measures;
+    end -= (end - first) / period * period;
+
+    for (; end <= _integrator.end(); end += period) {
+        LockinMeasure m;
+        if (average(end, integrationTime, &m))
+            measures << m;
     }
+    return measures;
+}
 
-    for (int j = 0; j < periodSize; ++j) {
-        _complex_exp << NAN;
-    }
+void Lockin::readSoudCard(const QByteArray &data)
+{
+    decodeStereo(data, _format, _invertLR, _left_right);
+}
 
-    Q_ASSERT(_complex_exp.size() == _left_right.size());
+int Lockin::parseChopperSignal()
+{
+    return ::parseChopperSignal(_left_right, _complex_exp);
 }
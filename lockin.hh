@@ -26,8 +26,55 @@
 #include <QAudioInput>
 #include <QVector>
 #include <complex>
+#include <atomic>
+#include "prefixsum.hh"
+#include "phaseaverager.hh"
+#include "clockestimator.hh"
 
 class Fifo;
+class Recorder;
+class ShmRingWriter;
+
+// [s] longest integration time, the integrator keeps twice the longest window
+const qreal maxIntegrationTime = 100.0;
+
+// snapshot of the counters of a Lockin, see Lockin::stats()
+struct LockinStats {
+    enum Stage { Decode, Reference, Mix, Integrate, StageCount };
+    static const char *stageName(int stage);
+
+    qint64 lastNs[StageCount]; // duration of each stage for the last block
+    qint64 totalNs[StageCount]; // since start
+    qint64 blocks; // processed blocks
+    qint64 samples; // processed samples (per channel)
+    qint64 nanSamples; // samples discarded because outside of a complete chopper period
+    qint64 fifoBytes; // bytes waiting when the last block was read
+    qint64 integratorDepth; // valid values into the last integration window
+    qint64 gaps; // discontinuities detected with the device clock
+    qint64 droppedSamples; // samples lost in these gaps
+    qint64 lateBlocks; // blocks that arrived later than the fitted clock predicts (latency or loss), time base kept
+    qint64 overruns; // blocks read too late (more than two notify intervals in the fifo)
+    qint64 recorderQueue; // bytes waiting to be written by the recorder
+    qint64 recorderDropped; // bytes the recorder could not write in time
+    bool recorderError; // the disk refused a write of the recorder, the file is incomplete
+    qreal clockPpm; // rate of the device against the steady clock, NAN until measured (audio device only)
+};
+
+// one output of the lockin
+struct LockinMeasure {
+    enum Flag {
+        Gap = 0x1, // samples were lost inside the integration window
+        Overrun = 0x2 // the processing did fall behind inside the integration window
+    };
+
+    int channel; // index into Lockin::integrationTimes()
+    qint64 sampleIndex; // center of the integration window, counted from the start
+    qreal time; // [s] exact center of the integration window
+    qint64 systemTimeNs; // sampleIndex on the steady clock (see Lockin::monotonicNs and clock()), 0 if disabled
+    std::complex<qreal> value; // X + iY
+    quint32 flags;
+};
+Q_DECLARE_METATYPE(LockinMeasure)
 
 class Lockin : public QObject {
     Q_OBJECT
@@ -40,43 +87,145 @@ public:
 
     // Cannot be called when running
     bool start(const QAudioDeviceInfo &audioDevice, const QAudioFormat &format, int output_period = 500);
-    void setOutputPeriod(qreal outputPeriod);
+    // Start without audio device, the samples are given with feed() (file, benchmark, ...)
+    // firstSample is the index of the first sample given (to analyse a part of a recording)
+    bool startOffline(const QAudioFormat &format, qint64 firstSample = 0);
+    void feed(const QByteArray &data); // interleaved stereo samples in format()
+    // skip the reference extraction, reference is the sin/cos of each sample (see referenceFromEdges)
+    void feed(const QByteArray &data, const QVector<std::complex<qreal>> &reference);
+    /* The parameters below can be changed while running (from the thread of the lockin)
+     * the history of the integrator is kept : a new integration time gives its first
+     * output at the next block if the history is long enough
+     */
+    void setOutputPeriod(qreal outputPeriod); // [s] notify interval of the device
     qreal outputPeriod() const;
-    void setIntegrationTime(qreal integrationTime);
+    void setIntegrationTime(qreal integrationTime); // channel 0
     qreal integrationTime() const;
+    // more outputs from the same mixed signal, channels 1, 2, ... with these integration times
+    void setExtraIntegrationTimes(const QVector<qreal> &integrationTimes);
+    const QVector<qreal> &integrationTimes() const; // all the channels
+    int channelCount() const;
+    // the mixed signal of the last seconds is kept to recompute the outputs (see history())
+    // it is enlarged to twice the longest integration time, but never shrinks while running
+    void setHistoryLength(qreal seconds);
+    qreal historyLength() const;
     void setInvertLR(bool on);
+    /* Stamp the outputs also with the system steady clock, only with an audio device
+     * the true rate of the device is measured against the steady clock (see clockestimator.hh)
+     * so that the outputs of several devices share one time base
+     */
+    void setSystemClockTimestamps(bool on);
+    static qint64 monotonicNs(); // std::chrono::steady_clock in ns
+    const ClockEstimator &clock() const; // in the thread of the lockin
+    // time [s] of this lockin (LockinMeasure::time) at a steady clock instant, NAN without clock
+    qreal timeAt(qint64 systemNs) const;
 
     const QVector<QPair<qreal, qreal>> &raw_signals() const;
     const QVector<std::complex<qreal> > &complex_exp_signal() const;
     const QAudioFormat &format() const;
+    qreal referenceFrequency() const; // mean chopper frequency since start [Hz], not when the reference is given to feed()
     void stop();
 
+    // average of the signal by phase of the chopper, 0 bins disables it (default)
+    // can be called while running, setPhaseBins restarts the average
+    void setPhaseBins(int bins);
+    void setPhaseTimeConstant(qreal seconds);
+    const PhaseAverager &phaseAverager() const;
+
+    // raw stream recording into a WAV file, only when running
+    bool startRecording(const QString &path);
+    void stopRecording();
+    bool isRecording() const;
+
+    // every output also into a POSIX shared memory ring (see shmring.hh), kept across start/stop
+    bool startSharedMemory(const QString &name, int capacity = 4096);
+    void stopSharedMemory();
+    bool isSharingMemory() const;
+
+    // can be called from any thread, the counters are reset by start()
+    LockinStats stats() const;
+
+    /* Outputs recomputed from the history, for any integration time, in O(1) each
+     * valid while running (in the lockin thread) and after stop, until the next start
+     * flags are not set
+     */
+    const PrefixSum &integrator() const;
+    // window [end - integrationTime, end)
+    bool average(qint64 end, qreal integrationTime, LockinMeasure *measure) const;
+    // all the outputs of the history, the last one ends at the last sample
+    QVector<LockinMeasure> history(qreal integrationTime, qreal outputPeriod) const;
+
 signals:
     void newRawData();
-    void newValue(qreal time, qreal measure);
+    void newValue(qreal time, qreal measure); // channel 0 only
+    void newMeasure(const LockinMeasure &measure); // same as newValue with phase and flags, every channel
 
 private slots:
     void interpretInput();
 
 private:
-	void readSoudCard(); // write into _left_right
-    void parseChopperSignal(); // write into _complex_exp
+    bool prepare(const QAudioFormat &format, qint64 firstSample = 0);
+    void processBlock(const QByteArray &data, const QVector<std::complex<qreal>> *reference = nullptr);
+    void resetStats();
+    void checkDeviceClock(qint64 bytes);
+	void readSoudCard(const QByteArray &data); // write into _left_right
+    int parseChopperSignal(); // write into _complex_exp, returns the number of periods
+    void updateIntegration();
+    LockinMeasure stamp(qint64 from, qint64 to, std::complex<qreal> value) const;
 
 
     QAudioInput *_audioInput; // is null when lockin stoped
     Fifo *_fifo; // feeded by _audioInput
+    Recorder *_recorder; // is null when not recording
+    ShmRingWriter *_shm; // is null when not sharing
+    bool _offline; // started with startOffline()
 
     QAudioFormat _format; // don't change it during running
 
     bool _invertLR;
-    qreal _integrationTime; // don't change it during running
-    int _sampleIntegration; // don't change it during running
+    QVector<qreal> _integrationTimes; // per channel
+    QVector<qint64> _sampleIntegrations; // see updateIntegration()
 
     QVector<QPair<qreal, qreal>> _left_right; // raw signal
     QVector<std::complex<qreal>> _complex_exp; // sin/cos constructed from right signal
-    QList<std::complex<qreal>> _measures; // product of left signal with sin/cos
-
-    qreal _timeValue;
+    QVector<std::complex<qreal>> _mixed; // product of left signal with sin/cos
+    PrefixSum _integrator; // sums of _mixed since start
+    QVector<LockinMeasure> _outputs; // of the last block, one per channel
+    PhaseAverager _phaseAverager;
+    qreal _historyLength; // [s]
+
+    // time base : all the timestamps are derived from the sample index
+    qint64 _sampleIndex; // index of the next sample, including the lost ones
+    qint64 _firstSample; // _sampleIndex at start
+    bool _systemClock;
+    ClockEstimator _clock; // sample index -> steady clock
+
+    qint64 _referencePeriods; // complete chopper periods since start
+    qint64 _referenceSamples; // samples into these periods
+
+    int _notifyInterval; // [ms]
+    qint64 _lastGap; // the outputs with a window starting before these samples are flagged, -1 if none
+    qint64 _lastOverrun;
+    bool _late; // the last block did arrive late, see checkDeviceClock
+
+    // relaxed atomics : written once per block, read by stats()
+    struct {
+        std::atomic<qint64> lastNs[LockinStats::StageCount];
+        std::atomic<qint64> totalNs[LockinStats::StageCount];
+        std::atomic<qint64> blocks;
+        std::atomic<qint64> samples;
+        std::atomic<qint64> nanSamples;
+        std::atomic<qint64> fifoBytes;
+        std::atomic<qint64> integratorDepth;
+        std::atomic<qint64> gaps;
+        std::atomic<qint64> droppedSamples;
+        std::atomic<qint64> lateBlocks;
+        std::atomic<qint64> overruns;
+        std::atomic<qint64> recorderQueue;
+        std::atomic<qint64> recorderDropped;
+        std::atomic<bool> recorderError;
+        std::atomic<qint64> clockPpb; // LLONG_MIN until measured
+    } _stats;
 };
 
 #endif // LOCKIN_HPP
@@ -1,11 +1,20 @@
 include($$PWD/xygraph/xygraph.pri)
+include($$PWD/engine.pri)
 
-SOURCES += $$PWD/fifo.cc \
-    $$PWD/lockin_gui.cc \
-    $$PWD/lockin.cc
+SOURCES += $$PWD/lockin_gui.cc \
+    $$PWD/deviceprobe.cc \
+    $$PWD/envelope.cc \
+    $$PWD/lodhistory.cc \
+    $$PWD/glplot.cc \
+    $$PWD/fft.cc \
+    $$PWD/spectrum.cc
 
-HEADERS += $$PWD/fifo.hh \
-    $$PWD/lockin_gui.hh \
-    $$PWD/lockin.hh
+HEADERS += $$PWD/lockin_gui.hh \
+    $$PWD/deviceprobe.hh \
+    $$PWD/envelope.hh \
+    $$PWD/lodhistory.hh \
+    $$PWD/glplot.hh \
+    $$PWD/fft.hh \
+    $$PWD/spectrum.hh
 
 FORMS += $$PWD/lockin_gui.ui
@@ -23,9 +23,22 @@
 
 #include "lockin_gui.hh"
 #include "ui_lockin_gui.h"
+#include "replay.hh"
 #include <QSettings>
 #include <QDebug>
 #include <QMessageBox>
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QTextStream>
+#include <QBoxLayout>
+#include <QMouseEvent>
+#include <cmath>
+
+// bounds of the redraw interval [ms], see scheduleRedraw()
+static const int minFrameInterval = 20;
+static const int maxFrameInterval = 500;
 
 LockinGui::LockinGui(QWidget *parent) :
     QWidget(parent),
@@ -34,64 +47,177 @@ LockinGui::LockinGui(QWidget *parent) :
     ui->setupUi(this);
 
     _lockin = new Lockin(this);
+    _measures_from_lockin = false;
 
-    foreach (const QAudioDeviceInfo &device, QAudioDeviceInfo::availableDevices(QAudio::AudioInput)) {
-        if (device.deviceName().contains("alsa_input")) {
-            ui->audioDeviceSelector->addItem(device.deviceName(), qVariantFromValue(device));
-        }
-    }
+    // before any setting is restored : the auto-connected on_* slots use them
+    _group = new LockinGroup(this);
+    connect(_group, SIGNAL(newMeasure(int,LockinMeasure)), this, SLOT(getEngineValue(int,LockinMeasure)));
+    connect(_group, SIGNAL(started(int,bool)), this, SLOT(engineStarted(int,bool)));
+
+    _server = new MeasureServer(this);
+    connect(_lockin, SIGNAL(newMeasure(LockinMeasure)), _server, SLOT(publish(LockinMeasure)));
+
+    // the devices of the last run are shown until the probe thread answers
+    // they carry only their names : the lockin can start once the probe has found the devices
+    qRegisterMetaType<QList<DeviceCapabilities>>();
+    setDevices(DeviceProbe::cached());
+    ui->buttonStartStop->setEnabled(false);
+    _probe = new DeviceProbe;
+    _probe->moveToThread(&_probe_thread);
+    connect(&_probe_thread, SIGNAL(finished()), _probe, SLOT(deleteLater()));
+    connect(_probe, SIGNAL(ready(QList<DeviceCapabilities>)), this, SLOT(devicesProbed(QList<DeviceCapabilities>)));
+    _probe_thread.start();
+    QMetaObject::invokeMethod(_probe, "probe", Qt::QueuedConnection);
 
     QSettings set;
+    ui->integrationTime->setMaximum(maxIntegrationTime);
     ui->outputPeriod->setValue(set.value("output period", ui->outputPeriod->value()).toDouble());
     ui->integrationTime->setValue(set.value("integration time", _lockin->integrationTime()).toDouble());
+    ui->extraIntegrationTimes->setText(set.value("other integration times").toString());
+
+    // the vumeter is decimated into a worker thread
+    qRegisterMetaType<VumeterBlock>();
+    qRegisterMetaType<VumeterEnvelope>();
+    _vumeter_pending = false;
+    _vumeter_decimator = new VumeterDecimator;
+    _vumeter_decimator->moveToThread(&_vumeter_thread);
+    connect(&_vumeter_thread, SIGNAL(finished()), _vumeter_decimator, SLOT(deleteLater()));
+    connect(_vumeter_decimator, SIGNAL(ready(VumeterEnvelope)), this, SLOT(setVumeter(VumeterEnvelope)));
+    _vumeter_thread.start();
+
+    // the spectrum too, into its own thread
+    qRegisterMetaType<SpectrumBlock>();
+    qRegisterMetaType<Spectrum>();
+    _spectrum_pending = 0;
+    _spectrum_skipped = false;
+    _spectrum_analyzer = new SpectrumAnalyzer;
+    _spectrum_analyzer->moveToThread(&_spectrum_thread);
+    connect(&_spectrum_thread, SIGNAL(finished()), _spectrum_analyzer, SLOT(deleteLater()));
+    connect(_spectrum_analyzer, SIGNAL(ready(Spectrum)), this, SLOT(setSpectrum(Spectrum)));
+    _spectrum_thread.start();
 
     connect(_lockin, SIGNAL(newRawData()), this, SLOT(updateGraphs()));
-    connect(_lockin, SIGNAL(newValue(qreal,qreal)), this, SLOT(getValue(qreal,qreal)));
+    connect(_lockin, SIGNAL(newMeasure(LockinMeasure)), this, SLOT(getValue(LockinMeasure)));
+
+    ui->publishAddress->setText(set.value("publish address", ui->publishAddress->text()).toString());
+    ui->publish->setChecked(set.value("publish", false).toBool());
+    ui->sharedMemoryName->setText(set.value("shared memory name", ui->sharedMemoryName->text()).toString());
+    ui->sharedMemory->setChecked(set.value("shared memory", false).toBool());
+
+    // a GlPlot waits next to each XY::Graph for the OpenGL mode
+    _left.setGraphs(ui->left, new GlPlot(ui->left->parentWidget()));
+    _right.setGraphs(ui->right, new GlPlot(ui->right->parentWidget()));
+    _output.setGraphs(ui->output, new GlPlot(ui->output->parentWidget()));
+    _waveform.setGraphs(ui->waveform, new GlPlot(ui->waveform->parentWidget()));
+    _spectrum.setGraphs(ui->spectrum, new GlPlot(ui->spectrum->parentWidget()));
 
-    ui->left->backgroundBrush = QBrush(Qt::black);
-    ui->left->axesPen = QPen(Qt::lightGray);
-    ui->left->subaxesPen = QPen(QBrush(Qt::darkGray), 1, Qt::DashLine);
-    ui->left->textPen = QPen(Qt::gray);
-    ui->left->setZoom(0, 100, -1.1, 1.1);
+    _left.setStyle(QBrush(Qt::black), QPen(Qt::lightGray), QPen(QBrush(Qt::darkGray), 1, Qt::DashLine), QPen(Qt::gray));
+    _left.setZoom(0, 100, -1.1, 1.1);
 
     _vumeter_left_plot.linePen = QPen(QBrush(Qt::white), 1.5);
     _vumeter_left_plot.dotRadius = 0.0;
-    ui->left->pointLists << &_vumeter_left_plot;
+    _left.addPointList(&_vumeter_left_plot);
 
 
-    ui->right->backgroundBrush = QBrush(Qt::black);
-    ui->right->axesPen = QPen(Qt::lightGray);
-    ui->right->subaxesPen = QPen(QBrush(Qt::darkGray), 1, Qt::DashLine);
-    ui->right->textPen = QPen(Qt::gray);
-    ui->right->setZoom(0, 100, -1.1, 1.1);
+    _right.setStyle(QBrush(Qt::black), QPen(Qt::lightGray), QPen(QBrush(Qt::darkGray), 1, Qt::DashLine), QPen(Qt::gray));
+    _right.setZoom(0, 100, -1.1, 1.1);
 
     _vumeter_right_plot.linePen = QPen(QBrush(Qt::white), 1.5);
     _vumeter_right_plot.dotRadius = 0.0;
     _vumeter_sin_plot.linePen = QPen(QBrush(Qt::gray), 1., Qt::DashLine);
     _vumeter_sin_plot.dotRadius = 0.0;
-    ui->right->pointLists << &_vumeter_right_plot;
-    ui->right->pointLists << &_vumeter_sin_plot;
+    _right.addPointList(&_vumeter_right_plot);
+    _right.addPointList(&_vumeter_sin_plot);
 
-    ui->output->backgroundBrush = QBrush(Qt::black);
-    ui->output->axesPen = QPen(Qt::lightGray);
-    ui->output->subaxesPen = QPen(QBrush(Qt::darkGray), 1, Qt::DashLine);
-    ui->output->textPen = QPen(Qt::gray);
-    ui->output->setZoom(0.0, 15.0, -1.0, 1.0);
+    _output.setStyle(QBrush(Qt::black), QPen(Qt::lightGray), QPen(QBrush(Qt::darkGray), 1, Qt::DashLine), QPen(Qt::gray));
+    _output.setZoom(0.0, 15.0, -1.0, 1.0);
 
     _measures_plot.linePen = QPen(QBrush(Qt::white), 1.5);
     _measures_plot.dotRadius = 0.0;
-    ui->output->pointLists << &_measures_plot;
+    _output.addPointList(&_measures_plot);
+
+    _waveform.setStyle(QBrush(Qt::black), QPen(Qt::lightGray), QPen(QBrush(Qt::darkGray), 1, Qt::DashLine), QPen(Qt::gray));
+    _waveform.setZoom(0.0, 360.0, -1.1, 1.1);
+    _waveform_plot.linePen = QPen(QBrush(Qt::white), 1.5);
+    _waveform_plot.dotRadius = 0.0;
+    _waveform.addPointList(&_waveform_plot);
+
+    ui->phaseBins->setValue(set.value("phase bins", ui->phaseBins->value()).toInt());
+    ui->phaseTimeConstant->setValue(set.value("phase time constant", ui->phaseTimeConstant->value()).toDouble());
+    _lockin->setPhaseTimeConstant(ui->phaseTimeConstant->value());
+    connect(_lockin, SIGNAL(newRawData()), this, SLOT(updateWaveform()));
+
+    _spectrum.setStyle(QBrush(Qt::black), QPen(Qt::lightGray), QPen(QBrush(Qt::darkGray), 1, Qt::DashLine), QPen(Qt::gray));
+    _spectrum.setZoom(1.0, 4.5, -160.0, 0.0);
+    _spectrum_plot.linePen = QPen(QBrush(Qt::white), 1.0);
+    _spectrum_plot.dotRadius = 0.0;
+    _spectrum.addPointList(&_spectrum_plot);
+    for (int n = 1024; n <= 65536; n *= 2)
+        ui->fftSize->addItem(QString("%1 points").arg(n), n);
+    ui->fftSize->setCurrentIndex(ui->fftSize->findData(set.value("fft size", 8192).toInt()));
+    ui->spectrumAverages->setValue(set.value("spectrum averages", ui->spectrumAverages->value()).toInt());
+    connect(_lockin, SIGNAL(newRawData()), this, SLOT(updateSpectrum()));
 
     _regraph_timer.setSingleShot(true);
     connect(&_regraph_timer, SIGNAL(timeout()), this, SLOT(regraph()));
+    _dirty = 0;
+
+    _stats = LockinGuiStats();
+    _stats.frameIntervalMs = minFrameInterval;
+    ui->left->installEventFilter(this);
+    ui->right->installEventFilter(this);
+    ui->output->installEventFilter(this);
+    ui->waveform->installEventFilter(this);
+    ui->spectrum->installEventFilter(this);
+    foreach (GlPlot *graph, findChildren<GlPlot *>()) {
+        graph->installEventFilter(this);
+    }
+    ui->openglPlots->setChecked(set.value("opengl plots", false).toBool());
+
+    // the diagnostics are only computed when they are visible
+    ui->label_diagnostics->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    connect(&_diagnostics_timer, SIGNAL(timeout()), this, SLOT(updateDiagnostics()));
+    _diagnostics_timer.setInterval(500);
+    on_tabWidget_currentChanged(ui->tabWidget->currentIndex());
 }
 
 LockinGui::~LockinGui()
 {
     QSettings set;
+    set.setValue("audio device", ui->audioDeviceSelector->currentText());
+    set.setValue("sample rate", ui->sampleRateComboBox->currentData());
+    set.setValue("sample size", ui->sampleSizeComboBox->currentData());
+    QStringList others;
+    for (int i = 0; i < ui->otherDevices->count(); ++i) {
+        if (ui->otherDevices->item(i)->checkState() == Qt::Checked)
+            others << ui->otherDevices->item(i)->text();
+    }
+    set.setValue("other devices", others);
     set.setValue("output period", ui->outputPeriod->value());
     set.setValue("integration time", ui->integrationTime->value());
+    set.setValue("other integration times", ui->extraIntegrationTimes->text());
+    set.setValue("opengl plots", ui->openglPlots->isChecked());
+    set.setValue("phase bins", ui->phaseBins->value());
+    set.setValue("phase time constant", ui->phaseTimeConstant->value());
+    set.setValue("fft size", ui->fftSize->currentData());
+    set.setValue("publish", ui->publish->isChecked());
+    set.setValue("publish address", ui->publishAddress->text());
+    set.setValue("shared memory", ui->sharedMemory->isChecked());
+    set.setValue("shared memory name", ui->sharedMemoryName->text());
+    set.setValue("spectrum averages", ui->spectrumAverages->value());
 
+    _group->stop();
+    _probe_thread.quit();
+    _probe_thread.wait();
+    _vumeter_thread.quit();
+    _vumeter_thread.wait();
+    _spectrum_thread.quit();
+    _spectrum_thread.wait();
+
+    qDeleteAll(_channel_plots);
+    qDeleteAll(_channel_histories);
+    qDeleteAll(_engine_plots);
+    qDeleteAll(_engine_histories);
     delete ui;
 }
 
@@ -105,6 +231,32 @@ const QTime &LockinGui::start_time() const
     return _start_time;
 }
 
+LockinGuiStats LockinGui::stats() const
+{
+    return _stats;
+}
+
+bool LockinGui::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::Paint) {
+        int i = _left.owns(watched) ? 0 : _right.owns(watched) ? 1 : _output.owns(watched) ? 2 : _waveform.owns(watched) ? 3 : 4;
+        // paint ourself to measure the time spent into the graph
+        QElapsedTimer timer;
+        timer.start();
+        watched->event(event);
+        _stats.paintNs[i] = timer.nsecsElapsed();
+        return true;
+    }
+    // the zoom of the output graph has changed, render the history at the new scale
+    // a move only pans with a button pressed, hovering changes nothing
+    const bool drag = event->type() == QEvent::MouseMove && static_cast<QMouseEvent *>(event)->buttons() != Qt::NoButton;
+    if (_output.owns(watched) && (event->type() == QEvent::Wheel || event->type() == QEvent::MouseButtonRelease
+                                  || drag || event->type() == QEvent::Resize)) {
+        scheduleRedraw(OutputGraph);
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
 void LockinGui::on_checkBox_clicked(bool checked)
 {
     _lockin->setInvertLR(checked);
@@ -112,18 +264,71 @@ void LockinGui::on_checkBox_clicked(bool checked)
 
 void LockinGui::on_audioDeviceSelector_currentIndexChanged(int arg1)
 {
-    QAudioDeviceInfo selected_device = ui->audioDeviceSelector->itemData(arg1).value<QAudioDeviceInfo>();
+    fillFormats(ui->audioDeviceSelector->itemText(arg1), 0, 0);
+}
+
+// keeps the selection, or restores the one of the last run when the list was empty
+void LockinGui::setDevices(const QList<DeviceCapabilities> &devices)
+{
+    QSettings set;
+    const bool first = ui->audioDeviceSelector->count() == 0;
+    const QString name = first ? set.value("audio device").toString() : ui->audioDeviceSelector->currentText();
+    const int rate = first ? set.value("sample rate").toInt() : ui->sampleRateComboBox->currentData().toInt();
+    const int size = first ? set.value("sample size").toInt() : ui->sampleSizeComboBox->currentData().toInt();
+
+    QStringList others = set.value("other devices").toStringList();
+    if (!first) {
+        others.clear();
+        for (int i = 0; i < ui->otherDevices->count(); ++i) {
+            if (ui->otherDevices->item(i)->checkState() == Qt::Checked)
+                others << ui->otherDevices->item(i)->text();
+        }
+    }
+
+    _devices.clear();
+    ui->otherDevices->clear();
+    ui->audioDeviceSelector->blockSignals(true);
+    ui->audioDeviceSelector->clear();
+    foreach (const DeviceCapabilities &device, devices) {
+        if (device.name.contains("alsa_input")) {
+            ui->audioDeviceSelector->addItem(device.name);
+            _devices[device.name] = device;
+
+            QListWidgetItem *item = new QListWidgetItem(device.name, ui->otherDevices);
+            item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+            item->setCheckState(others.contains(device.name) ? Qt::Checked : Qt::Unchecked);
+        }
+    }
+    ui->audioDeviceSelector->setCurrentIndex(qMax(0, ui->audioDeviceSelector->findText(name)));
+    ui->audioDeviceSelector->blockSignals(false);
+
+    fillFormats(ui->audioDeviceSelector->currentText(), rate, size);
+}
+
+void LockinGui::devicesProbed(const QList<DeviceCapabilities> &devices)
+{
+    DeviceProbe::store(devices);
+    setDevices(devices);
+    ui->buttonStartStop->setEnabled(true);
+}
+
+// rate and size are selected if the device supports them, otherwise the first rate and the largest size
+void LockinGui::fillFormats(const QString &device, int rate, int size)
+{
+    const DeviceCapabilities capabilities = _devices.value(device);
 
     ui->sampleRateComboBox->clear();
-    foreach (int rate, selected_device.supportedSampleRates()) {
-        ui->sampleRateComboBox->addItem(QString::number(rate), rate);
+    foreach (int r, capabilities.sampleRates) {
+        ui->sampleRateComboBox->addItem(QString::number(r), r);
     }
+    ui->sampleRateComboBox->setCurrentIndex(qMax(0, ui->sampleRateComboBox->findData(rate)));
 
     ui->sampleSizeComboBox->clear();
-    foreach (int size, selected_device.supportedSampleSizes()) {
-        ui->sampleSizeComboBox->addItem(QString::number(size), size);
+    foreach (int s, capabilities.sampleSizes) {
+        ui->sampleSizeComboBox->addItem(QString::number(s), s);
     }
-    ui->sampleSizeComboBox->setCurrentIndex(ui->sampleSizeComboBox->count() - 1);
+    int i = ui->sampleSizeComboBox->findData(size);
+    ui->sampleSizeComboBox->setCurrentIndex(i >= 0 ? i : ui->sampleSizeComboBox->count() - 1);
 }
 
 void LockinGui::on_buttonStartStop_clicked()
@@ -135,60 +340,518 @@ void LockinGui::on_buttonStartStop_clicked()
     }
 }
 
-void LockinGui::updateGraphs()
+void LockinGui::on_openLog_clicked()
 {
-    const QVector<QPair<qreal, qreal>> &data = _lockin->raw_signals();
-    const QVector<std::complex<qreal>> &sin_cos = _lockin->complex_exp_signal();
-    _vumeter_left_plot.clear();
-    _vumeter_right_plot.clear();
-    _vumeter_sin_plot.clear();
-    qreal msPerDot = 1000.0 / qreal(_lockin->format().sampleRate());
-
-    int trigger = 0;
-    for (int i = 0; i < qMin(data.size(), 2048); ++i) {
-        if (!std::isnan(sin_cos[i].real()) && !std::isnan(sin_cos[i].imag())) {
-            trigger = i;
-            break;
-        }
+    QString path = QFileDialog::getOpenFileName(this, "Open log", QString(), "Lockin log (*.lklog)");
+    if (path.isEmpty())
+        return;
+
+    MeasureLogReader reader;
+    if (!reader.open(path)) {
+        QMessageBox::warning(this, "Open log fail", "Cannot read " + path);
+        return;
     }
 
-    for (int i = 0; i < qMin(data.size(), 2048); ++i) {
-        qreal t = qreal(i - trigger) * msPerDot;
-        _vumeter_left_plot.append(QPointF(t, data[i].first));
-        _vumeter_right_plot.append(QPointF(t, data[i].second));
-        if (!std::isnan(sin_cos[i].real())) {
-            _vumeter_sin_plot.append(QPointF(t, sin_cos[i].imag()));
-        }
+    _measures_history.clear();
+    _measures_from_lockin = false;
+    setupChannelPlots(1);
+    setupEnginePlots(0);
+    qreal ymin = 0.0, ymax = 0.0;
+    for (qint64 i = 0; i < reader.size(); ++i) {
+        qreal r = reader.at(i).r;
+        _measures_history.append(reader.time(i), r);
+        ymin = qMin(ymin, r);
+        ymax = qMax(ymax, r);
+    }
+
+    if (reader.size() > 0) {
+        _output.setZoom(0.0, reader.time(reader.size() - 1), ymin, 1.1 * ymax);
+    }
+    ui->tabWidget->setCurrentWidget(ui->tab_2);
+    scheduleRedraw(OutputGraph);
+}
+
+void LockinGui::on_analyseRecording_clicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Analyse recording", QString(), "Recordings (*.wav *.lkf)");
+    if (path.isEmpty())
+        return;
+
+    QProgressDialog dialog("Analysing " + path, "Cancel", 0, 1000, this);
+    dialog.setWindowModality(Qt::WindowModal);
+    auto progress = [&](qreal fraction) {
+        dialog.setValue(int(1000 * fraction));
+        QCoreApplication::processEvents();
+        return !dialog.wasCanceled();
+    };
+
+    // the reference index is built only the first time
+    dialog.setLabelText("Searching the reference edges of " + path);
+    Replay replay;
+    if (!replay.open(path, ui->checkBox->isChecked(), progress)) {
+        if (!dialog.wasCanceled())
+            QMessageBox::warning(this, "Analyse recording fail", "Cannot read " + path);
+        return;
+    }
+
+    Lockin lockin;
+    lockin.setIntegrationTime(ui->integrationTime->value());
+    lockin.setExtraIntegrationTimes(extraIntegrationTimes());
+    setupChannelPlots(lockin.channelCount());
+    setupEnginePlots(0);
+    connect(&lockin, SIGNAL(newMeasure(LockinMeasure)), this, SLOT(getValue(LockinMeasure)));
+
+    _measures_history.clear();
+    _measures_from_lockin = false;
+    _run_time.start();
+    dialog.setLabelText("Analysing " + path);
+    if (!replay.run(&lockin, ui->outputPeriod->value(), 0, -1, progress)) {
+        if (dialog.wasCanceled())
+            QMessageBox::information(this, "Analyse recording", "Canceled, only the beginning of " + path + " is analysed.");
+        else
+            QMessageBox::warning(this, "Analyse recording fail", "Cannot analyse " + path);
+    }
+
+    ui->tabWidget->setCurrentWidget(ui->tab_2);
+    scheduleRedraw(OutputGraph);
+}
+
+void LockinGui::on_integrationTime_valueChanged(double value)
+{
+    if (_lockin->isRunning())
+        _lockin->setIntegrationTime(value);
+    if (_log.isOpen())
+        _log.setIntegrationTime(value);
+    if (_group->isRunning()) {
+        _group->setIntegrationTime(value);
+        clearEngineHistories();
+    }
+
+    if (_measures_from_lockin) {
+        redrawFromHistory(_measures_history, value);
+        scheduleRedraw(OutputGraph);
+    }
+}
+
+void LockinGui::on_outputPeriod_valueChanged(double value)
+{
+    if (_lockin->isRunning())
+        _lockin->setOutputPeriod(value);
+    if (_group->isRunning()) {
+        _group->setOutputPeriod(value);
+        clearEngineHistories();
+    }
+}
+
+void LockinGui::on_extraIntegrationTimes_editingFinished()
+{
+    QVector<qreal> times = extraIntegrationTimes();
+    if (_lockin->isRunning())
+        _lockin->setExtraIntegrationTimes(times);
+    if (_group->isRunning()) {
+        _group->setExtraIntegrationTimes(times);
+        clearEngineHistories();
+    }
+
+    if (_measures_from_lockin) {
+        setupChannelPlots(times.size() + 1);
+        for (int i = 0; i < times.size(); ++i)
+            redrawFromHistory(*_channel_histories[i], times[i]);
+        scheduleRedraw(OutputGraph);
+    }
+}
+
+// the stored sums give the outputs for another integration time without a new acquisition
+// the points older than the history of the lockin are kept if possible
+void LockinGui::redrawFromHistory(LodHistory &history, qreal integrationTime)
+{
+    QVector<LockinMeasure> measures = _lockin->history(integrationTime, ui->outputPeriod->value());
+    if (measures.isEmpty())
+        return;
+
+    if (!history.removeFrom(measures.first().time))
+        history.clear();
+    for (int i = 0; i < measures.size(); ++i)
+        history.append(measures[i].time, std::abs(measures[i].value));
+}
+
+void LockinGui::on_openglPlots_toggled(bool checked)
+{
+    _left.setOpenGL(checked);
+    _right.setOpenGL(checked);
+    _output.setOpenGL(checked);
+    _waveform.setOpenGL(checked);
+    _spectrum.setOpenGL(checked);
+    scheduleRedraw(AllGraphs);
+}
+
+void LockinGui::on_publish_toggled(bool checked)
+{
+    if (!checked) {
+        _server->close();
+        return;
+    }
+    if (!_server->listen(ui->publishAddress->text())) {
+        QMessageBox::warning(this, "Publish fail", "Cannot listen on " + ui->publishAddress->text());
+        ui->publish->setChecked(false);
+    }
+}
+
+void LockinGui::on_publishAddress_editingFinished()
+{
+    if (ui->publish->isChecked())
+        on_publish_toggled(true);
+}
+
+void LockinGui::on_sharedMemory_toggled(bool checked)
+{
+    if (!checked) {
+        _lockin->stopSharedMemory();
+        return;
+    }
+    if (!_lockin->startSharedMemory(ui->sharedMemoryName->text())) {
+        QMessageBox::warning(this, "Shared memory fail", "Cannot create " + ui->sharedMemoryName->text());
+        ui->sharedMemory->setChecked(false);
+    }
+}
+
+void LockinGui::on_sharedMemoryName_editingFinished()
+{
+    if (ui->sharedMemory->isChecked())
+        on_sharedMemory_toggled(true);
+}
+
+void LockinGui::updateGraphs()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // the decimator is still busy with an older block, or nobody looks at the vumeter
+    if (_vumeter_pending || !(canSee(_left) || canSee(_right)))
+        return;
+
+    // one column per pixel of the visible time range
+    VumeterBlock block;
+    block.left_right = _lockin->raw_signals();
+    block.complex_exp = _lockin->complex_exp_signal();
+    block.msPerDot = 1000.0 / qreal(_lockin->format().sampleRate());
+    block.samplesPerColumn = int(_left.xwidth() / block.msPerDot / qMax(1, _left.width()));
+
+    _vumeter_pending = true;
+    QMetaObject::invokeMethod(_vumeter_decimator, "decimate", Qt::QueuedConnection, Q_ARG(VumeterBlock, block));
+
+    _stats.updateGraphsNs = timer.nsecsElapsed();
+}
+
+void LockinGui::setVumeter(const VumeterEnvelope &envelope)
+{
+    _vumeter_pending = false;
+
+    // XY::PointList is a QList<QPointF> : the lists are shared, not copied
+    static_cast<QList<QPointF> &>(_vumeter_left_plot) = envelope.left;
+    static_cast<QList<QPointF> &>(_vumeter_right_plot) = envelope.right;
+    static_cast<QList<QPointF> &>(_vumeter_sin_plot) = envelope.sin;
+
+    scheduleRedraw(LeftGraph | RightGraph);
+
+    _stats.vumeterPoints = _vumeter_left_plot.size() + _vumeter_right_plot.size() + _vumeter_sin_plot.size();
+    _stats.decimateNs = envelope.decimateNs;
+}
+
+void LockinGui::updateWaveform()
+{
+    if (!canSee(_waveform))
+        return;
+
+    // one point at the center of each bin
+    QVector<qreal> waveform = _lockin->phaseAverager().waveform();
+    _waveform_plot.clear();
+    for (int b = 0; b < waveform.size(); ++b) {
+        if (!std::isnan(waveform[b]))
+            _waveform_plot << QPointF((b + 0.5) * 360.0 / waveform.size(), waveform[b]);
     }
+    scheduleRedraw(WaveformGraph);
+}
+
+void LockinGui::on_phaseBins_valueChanged(int bins)
+{
+    if (ui->tabWidget->currentWidget() == ui->tab_waveform)
+        _lockin->setPhaseBins(bins);
+}
+
+void LockinGui::on_phaseTimeConstant_valueChanged(double seconds)
+{
+    _lockin->setPhaseTimeConstant(seconds);
+}
+
+void LockinGui::on_resetWaveform_clicked()
+{
+    updatePhaseAveraging(true);
+    _waveform_plot.clear();
+    scheduleRedraw(WaveformGraph);
+}
 
-    if (!_regraph_timer.isActive()) {
-        _regraph_timer.start(50);
+void LockinGui::updateSpectrum()
+{
+    if (!canSee(_spectrum)) {
+        _spectrum_skipped = true;
+        return;
+    }
+    // at most two blocks waiting, the analyser restarts its segments after a skip
+    if (_spectrum_pending >= 2) {
+        _spectrum_skipped = true;
+        return;
     }
+
+    SpectrumBlock block;
+    block.left_right = _lockin->raw_signals();
+    block.sampleRate = _lockin->format().sampleRate();
+    block.fftSize = ui->fftSize->currentData().toInt();
+    block.averages = ui->spectrumAverages->value();
+    block.columns = _spectrum.width();
+    block.continuous = !_spectrum_skipped;
+    _spectrum_skipped = false;
+
+    _spectrum_pending++;
+    QMetaObject::invokeMethod(_spectrum_analyzer, "addBlock", Qt::QueuedConnection, Q_ARG(SpectrumBlock, block));
+}
+
+void LockinGui::setSpectrum(const Spectrum &spectrum)
+{
+    _spectrum_pending--;
+
+    static_cast<QList<QPointF> &>(_spectrum_plot) = spectrum.points;
+    _stats.spectrumNs = spectrum.computeNs;
+    scheduleRedraw(SpectrumGraph);
 }
 
-void LockinGui::getValue(qreal time, qreal measure)
+void LockinGui::getValue(const LockinMeasure &m)
 {
-    ui->label_current_value->setText(QString::number(measure));
+    QElapsedTimer timer;
+    timer.start();
+
+    qreal time = m.time;
+    qreal measure = std::abs(m.value);
+
+    // the other integration times are only drawn
+    if (m.channel != 0) {
+        if (m.channel <= _channel_histories.size())
+            _channel_histories[m.channel - 1]->append(time, measure);
+        scheduleRedraw(OutputGraph);
+        return;
+    }
+
+    QString text = QString::number(measure);
+    if (m.flags & LockinMeasure::Gap)
+        text += " (samples lost)";
+    if (m.flags & LockinMeasure::Overrun)
+        text += " (overrun)";
+    ui->label_current_value->setText(text);
+
+    if (_log.isOpen())
+        _log.append(m);
     ui->label_current_time->setText(QTime(0, 0).addMSecs(1000 * time).toString());
     ui->label_real_time->setText(QTime(0, 0).addMSecs(_run_time.elapsed()).toString());
 
-    _measures_plot << QPointF(time, measure);
+    _measures_history.append(time, measure);
     emit newValue();
 
-    if (ui->output->xmax() < time && ui->output->xmax() > time * 0.9)
-        ui->output->setxmax(time + 0.20 * ui->output->xwidth());
+    if (_output.xmax() < time && _output.xmax() > time * 0.9)
+        _output.setxmax(time + 0.20 * _output.xwidth());
+    scheduleRedraw(OutputGraph);
+
+    _stats.getValueNs = timer.nsecsElapsed();
+}
+
+bool LockinGui::canSee(const PlotView &view) const
+{
+    return view.isVisible() && !window()->isMinimized();
+}
+
+/* The graphs are redrawn by one timer : the changes between two frames are coalesced
+ * The interval follows the paint cost of the dirty graphs (a quarter of a core at most)
+ */
+void LockinGui::scheduleRedraw(int graphs)
+{
+    _dirty |= graphs;
+    if (_dirty == 0 || _regraph_timer.isActive())
+        return;
+
+    qint64 costNs = 0;
+    if (_dirty & LeftGraph)
+        costNs += _stats.paintNs[0];
+    if (_dirty & RightGraph)
+        costNs += _stats.paintNs[1];
+    if (_dirty & OutputGraph)
+        costNs += _stats.paintNs[2];
+    if (_dirty & WaveformGraph)
+        costNs += _stats.paintNs[3];
+    if (_dirty & SpectrumGraph)
+        costNs += _stats.paintNs[4];
+
+    _stats.frameIntervalMs = qBound(minFrameInterval, int(4 * costNs / 1000000), maxFrameInterval);
+    _regraph_timer.start(_stats.frameIntervalMs);
 }
 
+// only the dirty and visible graphs, the hidden ones stay dirty until they are shown
 void LockinGui::regraph()
 {
-    ui->left->update();
-    ui->right->update();
-    ui->output->update();
+    if ((_dirty & OutputGraph) && canSee(_output)) {
+        renderOutput();
+        _output.update();
+        _dirty &= ~OutputGraph;
+    }
+    if ((_dirty & LeftGraph) && canSee(_left)) {
+        _left.update();
+        _dirty &= ~LeftGraph;
+    }
+    if ((_dirty & RightGraph) && canSee(_right)) {
+        _right.update();
+        _dirty &= ~RightGraph;
+    }
+    if ((_dirty & WaveformGraph) && canSee(_waveform)) {
+        _waveform.update();
+        _dirty &= ~WaveformGraph;
+    }
+    if ((_dirty & SpectrumGraph) && canSee(_spectrum)) {
+        _spectrum.update();
+        _dirty &= ~SpectrumGraph;
+    }
+}
+
+void LockinGui::on_tabWidget_currentChanged(int index)
+{
+    if (ui->tabWidget->widget(index) == ui->tab_diagnostics) {
+        _diagnostics_timer.start();
+        updateDiagnostics();
+    } else {
+        _diagnostics_timer.stop();
+    }
+    updatePhaseAveraging(false);
+    scheduleRedraw(0);
+}
+
+// the phase averaging costs an atan2 per sample : it only runs while the Waveform tab is shown
+void LockinGui::updatePhaseAveraging(bool reset)
+{
+    const int bins = ui->tabWidget->currentWidget() == ui->tab_waveform ? ui->phaseBins->value() : 0;
+    if (reset || _lockin->phaseAverager().bins() != bins)
+        _lockin->setPhaseBins(bins);
+}
+
+void LockinGui::changeEvent(QEvent *event)
+{
+    // back from minimized
+    if (event->type() == QEvent::WindowStateChange)
+        scheduleRedraw(0);
+    QWidget::changeEvent(event);
+}
+
+void LockinGui::showEvent(QShowEvent *event)
+{
+    scheduleRedraw(0);
+    QWidget::showEvent(event);
+}
+
+// the plots of the output graph are rebuilt for its current zoom, one bucket per pixel
+void LockinGui::renderOutput()
+{
+    const qreal xmin = _output.xmax() - _output.xwidth();
+    const qreal xmax = _output.xmax();
+    const int columns = qMax(1, _output.width());
+
+    _measures_plot.clear();
+    _measures_history.render(xmin, xmax, columns, _measures_plot);
+    _stats.measuresPoints = _measures_plot.size();
+
+    for (int i = 0; i < _channel_plots.size(); ++i) {
+        _channel_plots[i]->clear();
+        _channel_histories[i]->render(xmin, xmax, columns, *_channel_plots[i]);
+        _stats.measuresPoints += _channel_plots[i]->size();
+    }
+
+    for (int i = 0; i < _engine_plots.size(); ++i) {
+        _engine_plots[i]->clear();
+        _engine_histories[i]->render(xmin, xmax, columns, *_engine_plots[i]);
+        _stats.measuresPoints += _engine_plots[i]->size();
+    }
+}
+
+void LockinGui::updateDiagnostics()
+{
+    if (!isVisible() || ui->tabWidget->currentWidget() != ui->tab_diagnostics)
+        return;
+
+    LockinStats ls = _lockin->stats();
+    QString text;
+    QTextStream out(&text);
+
+    out << "Engine (per block, last / mean in us)\n";
+    for (int i = 0; i < LockinStats::StageCount; ++i) {
+        out << QString("  %1 %2 / %3\n").arg(LockinStats::stageName(i), -12)
+               .arg(qreal(ls.lastNs[i]) * 1e-3, 10, 'f', 1)
+               .arg(ls.blocks > 0 ? qreal(ls.totalNs[i]) * 1e-3 / ls.blocks : 0.0, 10, 'f', 1);
+    }
+    out << QString("  blocks       %1\n").arg(ls.blocks);
+    out << QString("  samples      %1\n").arg(ls.samples);
+    out << QString("  NaN samples  %1 (%2 %)\n").arg(ls.nanSamples)
+           .arg(ls.samples > 0 ? 100.0 * ls.nanSamples / ls.samples : 0.0, 0, 'f', 2);
+    out << QString("  fifo         %1 bytes\n").arg(ls.fifoBytes);
+    out << QString("  integrator   %1 values\n").arg(ls.integratorDepth);
+    out << QString("  gaps         %1 (%2 samples lost)\n").arg(ls.gaps).arg(ls.droppedSamples);
+    out << QString("  late blocks  %1\n").arg(ls.lateBlocks);
+    out << QString("  overruns     %1\n").arg(ls.overruns);
+    if (!std::isnan(ls.clockPpm))
+        out << QString("  clock        %1 ppm against the steady clock\n").arg(ls.clockPpm, 0, 'f', 3);
+    for (int i = 0; i < _group->size(); ++i) {
+        LockinStats es = _group->stats(i);
+        out << QString("  device %1     %2\n").arg(i + 1).arg(_group->deviceName(i));
+        out << QString("    blocks %1, mix %2 us, integrate %3 us, fifo %4 bytes, gaps %5 (%6 samples lost), late %7, overruns %8\n")
+               .arg(es.blocks)
+               .arg(qreal(es.lastNs[LockinStats::Mix]) * 1e-3, 0, 'f', 1)
+               .arg(qreal(es.lastNs[LockinStats::Integrate]) * 1e-3, 0, 'f', 1)
+               .arg(es.fifoBytes).arg(es.gaps).arg(es.droppedSamples).arg(es.lateBlocks).arg(es.overruns);
+        out << QString("    clock %1 ppm\n").arg(es.clockPpm, 0, 'f', 3);
+    }
+    if (_server->isListening()) {
+        MeasureServerStats ss = _server->stats();
+        out << QString("  publish      %1 clients, %2 frames, %3 dropped, %4 slow clients disconnected\n")
+               .arg(ss.clients).arg(ss.frames).arg(ss.droppedFrames).arg(ss.disconnectedClients);
+    }
+    if (_lockin->isRecording()) {
+        out << QString("  recorder     %1 bytes queued, %2 bytes dropped%3\n").arg(ls.recorderQueue).arg(ls.recorderDropped)
+               .arg(ls.recorderError ? ", write error" : "");
+    }
+
+    out << "\nGui (last call in us)\n";
+    out << QString("  updateGraphs %1\n").arg(qreal(_stats.updateGraphsNs) * 1e-3, 10, 'f', 1);
+    out << QString("  decimate     %1 (worker thread)\n").arg(qreal(_stats.decimateNs) * 1e-3, 10, 'f', 1);
+    out << QString("  getValue     %1\n").arg(qreal(_stats.getValueNs) * 1e-3, 10, 'f', 1);
+    out << QString("  paint left   %1\n").arg(qreal(_stats.paintNs[0]) * 1e-3, 10, 'f', 1);
+    out << QString("  paint right  %1\n").arg(qreal(_stats.paintNs[1]) * 1e-3, 10, 'f', 1);
+    out << QString("  paint output %1\n").arg(qreal(_stats.paintNs[2]) * 1e-3, 10, 'f', 1);
+    out << QString("  paint wave   %1\n").arg(qreal(_stats.paintNs[3]) * 1e-3, 10, 'f', 1);
+    out << QString("  paint spectr %1\n").arg(qreal(_stats.paintNs[4]) * 1e-3, 10, 'f', 1);
+    out << QString("  spectrum     %1 (worker thread)\n").arg(qreal(_stats.spectrumNs) * 1e-3, 10, 'f', 1);
+    out << QString("  frame        %1 ms interval\n").arg(_stats.frameIntervalMs);
+    out << QString("  vumeter      %1 points\n").arg(_stats.vumeterPoints);
+    out << QString("  waveform     %1 samples averaged\n").arg(_lockin->phaseAverager().samples());
+    out << QString("  output       %1 points drawn, %2 in history (%3 levels)\n").arg(_stats.measuresPoints)
+           .arg(_measures_history.size()).arg(_measures_history.levels());
+
+    out.flush();
+    ui->label_diagnostics->setText(text);
 }
 
 void LockinGui::startLockin()
 {
-    QAudioDeviceInfo selected_device = ui->audioDeviceSelector->itemData(ui->audioDeviceSelector->currentIndex()).value<QAudioDeviceInfo>();
+    const QString name = ui->audioDeviceSelector->currentText();
+    QAudioDeviceInfo selected_device = findDevice(name);
+    if (selected_device.isNull()) {
+        qDebug() << __FUNCTION__ << ": no audio input" << name;
+        QMessageBox::warning(this, "Start lockin fail", "No audio input " + name);
+        return;
+    }
 
 //    qDebug() << "========== device infos ========== ";
 //    showQAudioDeviceInfo(selected_device);
@@ -203,27 +866,233 @@ void LockinGui::startLockin()
     qDebug() << format;
 
     _lockin->setIntegrationTime(ui->integrationTime->value());
+    _lockin->setExtraIntegrationTimes(extraIntegrationTimes());
+    // the other devices are drawn on the time base of this one, through the steady clock
+    _lockin->setSystemClockTimestamps(hasOtherDevices());
+    setupChannelPlots(_lockin->channelCount());
 
     if (_lockin->start(selected_device, format, ui->outputPeriod->value() * 1000)) {
         _run_time.start();
         _start_time = QTime::currentTime();
 
-        _measures_plot.clear();
+        _measures_history.clear();
+        _measures_from_lockin = true;
         _vumeter_left_plot.clear();
         _vumeter_right_plot.clear();
 
-        ui->frame->setEnabled(false);
+        startOtherDevices(format);
+
+        setAcquisitionWidgetsEnabled(false);
         ui->buttonStartStop->setText("Stop !");
+
+        if (ui->logMeasures->isChecked()) {
+            QString path = QFileDialog::getSaveFileName(this, "Log measures", QString(), "Lockin log (*.lklog)");
+            if (!path.isEmpty() && !_log.open(path, format.sampleRate(), ui->integrationTime->value(), ui->outputPeriod->value())) {
+                QMessageBox::warning(this, "Log fail", "Cannot write into " + path);
+            }
+        }
+
+        if (ui->recordRaw->isChecked()) {
+            QString path = QFileDialog::getSaveFileName(this, "Record raw stream", QString(),
+                                                        "WAV (*.wav);;Lossless compressed (*.lkf)");
+            if (!path.isEmpty() && !_lockin->startRecording(path)) {
+                QMessageBox::warning(this, "Recording fail", "Cannot record into " + path);
+            }
+        }
     } else {
         qDebug() << __FUNCTION__ << ": cannot start lockin";
         QMessageBox::warning(this, "Start lockin fail", "Start has failed.");
     }
 }
 
+// from the last probe, never enumerates the devices on the GUI thread (see DeviceProbe)
+QAudioDeviceInfo LockinGui::findDevice(const QString &name) const
+{
+    return _devices.value(name).device;
+}
+
+bool LockinGui::hasOtherDevices() const
+{
+    for (int i = 0; i < ui->otherDevices->count(); ++i) {
+        const QListWidgetItem *item = ui->otherDevices->item(i);
+        if (item->checkState() == Qt::Checked && item->text() != ui->audioDeviceSelector->currentText())
+            return true;
+    }
+    return false;
+}
+
+// the checked devices with the format and the settings of the main one
+void LockinGui::startOtherDevices(const QAudioFormat &format)
+{
+    QList<LockinEngineSettings> engines;
+    for (int i = 0; i < ui->otherDevices->count(); ++i) {
+        const QListWidgetItem *item = ui->otherDevices->item(i);
+        if (item->checkState() != Qt::Checked || item->text() == ui->audioDeviceSelector->currentText())
+            continue;
+
+        LockinEngineSettings e;
+        e.device = findDevice(item->text());
+        if (e.device.isNull() || !e.device.isFormatSupported(format)) {
+            qDebug() << __FUNCTION__ << ": skip" << item->text();
+            QMessageBox::warning(this, "Start lockin fail", item->text() + " does not support the format");
+            continue;
+        }
+        e.format = format;
+        e.integrationTime = ui->integrationTime->value();
+        e.extraIntegrationTimes = extraIntegrationTimes();
+        e.outputPeriod = ui->outputPeriod->value();
+        e.invertLR = ui->checkBox->isChecked();
+        e.systemClock = true;
+        engines << e;
+    }
+
+    setupEnginePlots(engines.size());
+    if (!engines.isEmpty())
+        _group->start(engines);
+}
+
+void LockinGui::setupEnginePlots(int engines)
+{
+    static const Qt::GlobalColor colors[] = { Qt::cyan, Qt::magenta, Qt::green, Qt::yellow, Qt::red };
+
+    foreach (XY::PointList *plot, _engine_plots)
+        _output.removePointList(plot);
+    qDeleteAll(_engine_plots);
+    _engine_plots.clear();
+    qDeleteAll(_engine_histories);
+    _engine_histories.clear();
+    _engine_aligned.fill(false, engines);
+    _engine_last_time.fill(-INFINITY, engines);
+
+    for (int i = 0; i < engines; ++i) {
+        _engine_histories << new LodHistory;
+        XY::PointList *plot = new XY::PointList;
+        plot->linePen = QPen(QBrush(colors[i % 5]), 1.5, Qt::DashLine);
+        plot->dotRadius = 0.0;
+        _engine_plots << plot;
+        _output.addPointList(plot);
+    }
+}
+
+// the curves of the other devices restart with their new settings
+void LockinGui::clearEngineHistories()
+{
+    foreach (LodHistory *history, _engine_histories)
+        history->clear();
+    _engine_last_time.fill(-INFINITY);
+    scheduleRedraw(OutputGraph);
+}
+
+void LockinGui::engineStarted(int engine, bool ok)
+{
+    if (!ok)
+        QMessageBox::warning(this, "Start lockin fail", "Cannot start " + _group->deviceName(engine));
+}
+
+/* The other integration times of the other devices are not drawn
+ * each device has its own crystal : the outputs are placed on the time base
+ * of the main device through the steady clock, so that they stay aligned after hours
+ */
+void LockinGui::getEngineValue(int engine, const LockinMeasure &measure)
+{
+    if (measure.channel != 0 || engine >= _engine_histories.size())
+        return;
+
+    qreal time = measure.time;
+    bool aligned = false;
+    if (measure.systemTimeNs != 0 && _lockin->isRunning()) {
+        const qreal t = _lockin->timeAt(measure.systemTimeNs);
+        if (!std::isnan(t)) {
+            time = t;
+            aligned = true;
+        }
+    }
+
+    // the points of the other time base cannot be mixed into the same history
+    LodHistory *history = _engine_histories[engine];
+    if (aligned != _engine_aligned[engine]) {
+        history->clear();
+        _engine_aligned[engine] = aligned;
+        _engine_last_time[engine] = -INFINITY;
+    }
+    // the fit of the clocks moves a little, a point before the last one is dropped
+    if (time < _engine_last_time[engine])
+        return;
+    _engine_last_time[engine] = time;
+
+    history->append(time, std::abs(measure.value));
+    scheduleRedraw(OutputGraph);
+}
+
+QVector<qreal> LockinGui::extraIntegrationTimes() const
+{
+    QVector<qreal> times;
+    foreach (const QString &word, ui->extraIntegrationTimes->text().split(QRegExp("[\\s,;]+"), QString::SkipEmptyParts)) {
+        bool ok;
+        qreal t = word.toDouble(&ok);
+        if (!ok || t <= 0.0) {
+            qDebug() << __FUNCTION__ << ": ignore integration time" << word;
+            continue;
+        }
+        // the same limit as the main one : the integrator grows with the longest time
+        if (t > ui->integrationTime->maximum()) {
+            qDebug() << __FUNCTION__ << ": integration time" << word << "clamped to" << ui->integrationTime->maximum();
+            t = ui->integrationTime->maximum();
+        }
+        times << t;
+    }
+    return times;
+}
+
+void LockinGui::setupChannelPlots(int channels)
+{
+    static const Qt::GlobalColor colors[] = { Qt::yellow, Qt::cyan, Qt::magenta, Qt::green, Qt::red };
+
+    foreach (XY::PointList *plot, _channel_plots)
+        _output.removePointList(plot);
+    qDeleteAll(_channel_plots);
+    _channel_plots.clear();
+    qDeleteAll(_channel_histories);
+    _channel_histories.clear();
+
+    // channel 0 is _measures_plot
+    for (int i = 1; i < channels; ++i) {
+        _channel_histories << new LodHistory;
+        XY::PointList *plot = new XY::PointList;
+        plot->linePen = QPen(QBrush(colors[(i - 1) % 5]), 1.0);
+        plot->dotRadius = 0.0;
+        _channel_plots << plot;
+        _output.addPointList(plot);
+    }
+}
+
+// the integration times and the output period stay editable while running
+void LockinGui::setAcquisitionWidgetsEnabled(bool enabled)
+{
+    ui->audioDeviceSelector->setEnabled(enabled);
+    ui->sampleRateComboBox->setEnabled(enabled);
+    ui->sampleSizeComboBox->setEnabled(enabled);
+    ui->recordRaw->setEnabled(enabled);
+    ui->logMeasures->setEnabled(enabled);
+    ui->openLog->setEnabled(enabled);
+    ui->analyseRecording->setEnabled(enabled);
+    ui->otherDevices->setEnabled(enabled);
+}
+
 void LockinGui::stopLockin()
 {
+    if (_log.isOpen()) {
+        _log.setReferenceFrequency(_lockin->referenceFrequency());
+        _log.close();
+        if (_log.hasError())
+            QMessageBox::warning(this, "Log fail", "A write has failed, the log is incomplete.");
+    }
+    const bool recording = _lockin->isRecording();
     _lockin->stop();
-    ui->frame->setEnabled(true);
+    if (recording && _lockin->stats().recorderError)
+        QMessageBox::warning(this, "Recording fail", "A write has failed, the recording is incomplete.");
+    _group->stop();
+    setAcquisitionWidgetsEnabled(true);
     ui->buttonStartStop->setText("Start");
 }
 
@@ -238,3 +1107,109 @@ T maxInList(const QList<T> &list, T def)
 
 
 
+
+PlotView::PlotView() :
+    _xy(nullptr), _gl(nullptr), _useGl(false), _ymin(-1.0), _ymax(1.0)
+{
+}
+
+void PlotView::setGraphs(XY::Graph *xy, GlPlot *gl)
+{
+    _xy = xy;
+    _gl = gl;
+
+    // at the same place into the layout
+    QBoxLayout *layout = qobject_cast<QBoxLayout *>(_xy->parentWidget()->layout());
+    Q_ASSERT(layout);
+    layout->insertWidget(layout->indexOf(_xy) + 1, _gl);
+    _gl->hide();
+}
+
+// the x range is kept, the y range is the one of the last setZoom
+void PlotView::setOpenGL(bool on)
+{
+    if (on == _useGl)
+        return;
+
+    const qreal x1 = xmax();
+    const qreal x0 = x1 - xwidth();
+    _useGl = on;
+    _gl->setVisible(on);
+    _xy->setVisible(!on);
+    setZoom(x0, x1, _ymin, _ymax);
+}
+
+bool PlotView::owns(QObject *object) const
+{
+    return object == _xy || object == _gl;
+}
+
+void PlotView::setStyle(const QBrush &background, const QPen &axes, const QPen &subaxes, const QPen &text)
+{
+    _xy->backgroundBrush = background;
+    _xy->axesPen = axes;
+    _xy->subaxesPen = subaxes;
+    _xy->textPen = text;
+    _gl->backgroundBrush = background;
+    _gl->axesPen = axes;
+    _gl->subaxesPen = subaxes;
+    _gl->textPen = text;
+}
+
+void PlotView::addPointList(XY::PointList *list)
+{
+    _xy->pointLists << list;
+    _gl->pointLists << list;
+}
+
+void PlotView::removePointList(XY::PointList *list)
+{
+    _xy->pointLists.removeAll(list);
+    _gl->pointLists.removeAll(list);
+}
+
+void PlotView::setZoom(qreal xmin, qreal xmax, qreal ymin, qreal ymax)
+{
+    _ymin = ymin;
+    _ymax = ymax;
+    if (_useGl)
+        _gl->setZoom(xmin, xmax, ymin, ymax);
+    else
+        _xy->setZoom(xmin, xmax, ymin, ymax);
+}
+
+qreal PlotView::xmax() const
+{
+    return _useGl ? _gl->xmax() : _xy->xmax();
+}
+
+qreal PlotView::xwidth() const
+{
+    return _useGl ? _gl->xwidth() : _xy->xwidth();
+}
+
+void PlotView::setxmax(qreal xmax)
+{
+    if (_useGl)
+        _gl->setxmax(xmax);
+    else
+        _xy->setxmax(xmax);
+}
+
+int PlotView::width() const
+{
+    return _useGl ? _gl->width() : _xy->width();
+}
+
+void PlotView::update()
+{
+    if (_useGl)
+        _gl->update();
+    else
+        _xy->update();
+}
+
+bool PlotView::isVisible() const
+{
+    return _useGl ? _gl->isVisible() : _xy->isVisible();
+}
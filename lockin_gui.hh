@@ -26,13 +26,62 @@
 #include <QWidget>
 #include <QTime>
 #include <QTimer>
+#include <QThread>
+#include <QMap>
 #include "lockin.hh"
+#include "measurelog.hh"
+#include "measureserver.hh"
+#include "lockingroup.hh"
+#include "envelope.hh"
+#include "spectrum.hh"
+#include "deviceprobe.hh"
+#include "lodhistory.hh"
 #include "xygraph/xygraph.hh"
+#include "glplot.hh"
 
 namespace Ui {
 class LockinGui;
 }
 
+// timings of the gui thread, see LockinGui::stats()
+struct LockinGuiStats {
+    qint64 updateGraphsNs; // last call of updateGraphs()
+    qint64 decimateNs; // last vumeter decimation, in the worker thread
+    qint64 spectrumNs; // last spectrum block, in its worker thread
+    qint64 getValueNs; // last call of getValue()
+    qint64 paintNs[5]; // last paint of left, right, output, waveform and spectrum graphs
+    int frameIntervalMs; // current interval between two redraws
+    qint64 vumeterPoints; // points in the vumeter plots
+    qint64 measuresPoints; // points drawn in the output graph
+};
+
+// one graph drawn either by XY::Graph (QPainter) or by GlPlot (vertex buffers)
+class PlotView
+{
+public:
+    PlotView();
+    void setGraphs(XY::Graph *xy, GlPlot *gl); // gl is hidden
+    void setOpenGL(bool on);
+    bool owns(QObject *object) const;
+
+    void setStyle(const QBrush &background, const QPen &axes, const QPen &subaxes, const QPen &text);
+    void addPointList(XY::PointList *list);
+    void removePointList(XY::PointList *list);
+    void setZoom(qreal xmin, qreal xmax, qreal ymin, qreal ymax);
+    qreal xmax() const;
+    qreal xwidth() const;
+    void setxmax(qreal xmax);
+    int width() const;
+    bool isVisible() const;
+    void update();
+
+private:
+    XY::Graph *_xy;
+    GlPlot *_gl;
+    bool _useGl;
+    qreal _ymin, _ymax; // of the last setZoom, XY::Graph does not give them
+};
+
 class LockinGui : public QWidget
 {
     Q_OBJECT
@@ -41,38 +90,119 @@ public:
     explicit LockinGui(QWidget *parent = 0);
     ~LockinGui();
 
-    const QList<QPointF>& values() const;
+    const QList<QPointF>& values() const; // points drawn, see LodHistory
     const QTime& start_time() const;
+    LockinGuiStats stats() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
 
 private slots:
     void on_checkBox_clicked(bool checked);
     void on_audioDeviceSelector_currentIndexChanged(int arg1);
+    void setDevices(const QList<DeviceCapabilities> &devices);
+    void devicesProbed(const QList<DeviceCapabilities> &devices);
     void on_buttonStartStop_clicked();
+    void on_openLog_clicked();
+    void on_analyseRecording_clicked();
+    void on_integrationTime_valueChanged(double value);
+    void on_outputPeriod_valueChanged(double value);
+    void on_extraIntegrationTimes_editingFinished();
+    void on_openglPlots_toggled(bool checked);
+    void on_publish_toggled(bool checked);
+    void on_publishAddress_editingFinished();
+    void on_sharedMemory_toggled(bool checked);
+    void on_sharedMemoryName_editingFinished();
+    void on_tabWidget_currentChanged(int index);
     void updateGraphs();
-    void getValue(qreal time, qreal measure);
+    void setVumeter(const VumeterEnvelope &envelope);
+    void updateWaveform();
+    void on_phaseBins_valueChanged(int bins);
+    void on_phaseTimeConstant_valueChanged(double seconds);
+    void on_resetWaveform_clicked();
+    void updateSpectrum();
+    void setSpectrum(const Spectrum &spectrum);
+    void getValue(const LockinMeasure &measure);
+    void getEngineValue(int engine, const LockinMeasure &measure);
+    void engineStarted(int engine, bool ok);
     void regraph();
+    void updateDiagnostics();
 
 signals:
     void newValue();
 
 private:
+    enum Graph { LeftGraph = 0x1, RightGraph = 0x2, OutputGraph = 0x4, WaveformGraph = 0x8, SpectrumGraph = 0x10, AllGraphs = 0x1F };
+    void scheduleRedraw(int graphs); // graphs to redraw at the next frame
+    bool canSee(const PlotView &view) const;
+
     void startLockin();
     void stopLockin();
+    QVector<qreal> extraIntegrationTimes() const; // parsed from the line edit
+    void setupChannelPlots(int channels);
+    void redrawFromHistory(LodHistory &history, qreal integrationTime);
+    void renderOutput();
+    void setAcquisitionWidgetsEnabled(bool enabled);
+    void fillFormats(const QString &device, int rate, int size);
+    QAudioDeviceInfo findDevice(const QString &name) const;
+    bool hasOtherDevices() const;
+    void startOtherDevices(const QAudioFormat &format);
+    void setupEnginePlots(int engines);
+    void clearEngineHistories();
+    void updatePhaseAveraging(bool reset);
 
     Ui::LockinGui *ui;
 
     Lockin *_lockin;
+    MeasureLogWriter _log;
+    MeasureServer *_server; // publishes newMeasure to other processes
+    LockinGroup *_group; // the other devices, channel 0 is drawn
     QTime _run_time;
     QTimer _regraph_timer;
+    int _dirty; // Graph flags
     QTime _start_time;
+    QTimer _diagnostics_timer;
+    LockinGuiStats _stats;
+
+    QThread _probe_thread;
+    DeviceProbe *_probe; // lives into _probe_thread
+    QMap<QString, DeviceCapabilities> _devices; // shown into audioDeviceSelector
+
+    QThread _vumeter_thread;
+    VumeterDecimator *_vumeter_decimator; // lives into _vumeter_thread
+    bool _vumeter_pending; // a block is being decimated, the next ones are skipped
+
+    QThread _spectrum_thread;
+    SpectrumAnalyzer *_spectrum_analyzer; // lives into _spectrum_thread
+    int _spectrum_pending; // blocks sent and not yet analysed
+    bool _spectrum_skipped; // blocks were not sent since the last one
 
     // Plots
+    PlotView _left;
+    PlotView _right;
+    PlotView _output;
+    PlotView _waveform;
+    PlotView _spectrum;
+
     XY::PointList _vumeter_left_plot;
 
     XY::PointList _vumeter_right_plot;
     XY::PointList _vumeter_sin_plot;
 
-    XY::PointList _measures_plot;
+    XY::PointList _waveform_plot; // Lockin::phaseAverager()
+    XY::PointList _spectrum_plot;
+
+    XY::PointList _measures_plot; // rendered from _measures_history
+    LodHistory _measures_history;
+    bool _measures_from_lockin; // _measures_plot can be recomputed from the history of _lockin
+    QVector<XY::PointList *> _channel_plots; // outputs of the other integration times
+    QVector<LodHistory *> _channel_histories;
+    QVector<XY::PointList *> _engine_plots; // channel 0 of each engine of _group
+    QVector<LodHistory *> _engine_histories;
+    QVector<bool> _engine_aligned; // the history is on the time base of _lockin, otherwise on its own
+    QVector<qreal> _engine_last_time; // of the last point appended, the histories never go back
 };
 
 #endif // LOCKINGUI_HPP
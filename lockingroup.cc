@@ -0,0 +1,169 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "lockingroup.hh"
+#include <QDebug>
+#include <QThread>
+
+LockinEngine::LockinEngine(int index, const LockinEngineSettings &settings) :
+    QObject(nullptr), _index(index), _settings(settings)
+{
+    _lockin = new Lockin(this);
+    _lockin->setIntegrationTime(settings.integrationTime);
+    _lockin->setExtraIntegrationTimes(settings.extraIntegrationTimes);
+    _lockin->setInvertLR(settings.invertLR);
+    _lockin->setSystemClockTimestamps(settings.systemClock);
+    connect(_lockin, SIGNAL(newMeasure(LockinMeasure)), this, SLOT(forward(LockinMeasure)));
+}
+
+const LockinEngineSettings &LockinEngine::settings() const
+{
+    return _settings;
+}
+
+LockinStats LockinEngine::stats() const
+{
+    return _lockin->stats();
+}
+
+void LockinEngine::start()
+{
+    // the QAudioInput is created here, into the thread of the engine
+    bool ok = _lockin->start(_settings.device, _settings.format, int(_settings.outputPeriod * 1000.0));
+    if (!ok)
+        qDebug() << __FUNCTION__ << ": cannot start" << _settings.device.deviceName();
+    emit started(_index, ok);
+}
+
+void LockinEngine::stop()
+{
+    if (_lockin->isRunning())
+        _lockin->stop();
+}
+
+void LockinEngine::setIntegrationTime(qreal integrationTime)
+{
+    _settings.integrationTime = integrationTime;
+    _lockin->setIntegrationTime(integrationTime);
+}
+
+void LockinEngine::setExtraIntegrationTimes(const QVector<qreal> &integrationTimes)
+{
+    _settings.extraIntegrationTimes = integrationTimes;
+    _lockin->setExtraIntegrationTimes(integrationTimes);
+}
+
+void LockinEngine::setOutputPeriod(qreal outputPeriod)
+{
+    _settings.outputPeriod = outputPeriod;
+    if (_lockin->isRunning())
+        _lockin->setOutputPeriod(outputPeriod);
+}
+
+void LockinEngine::forward(const LockinMeasure &measure)
+{
+    emit newMeasure(_index, measure);
+}
+
+LockinGroup::LockinGroup(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<QVector<qreal>>();
+}
+
+LockinGroup::~LockinGroup()
+{
+    stop();
+}
+
+void LockinGroup::start(const QList<LockinEngineSettings> &engines)
+{
+    stop();
+
+    for (int i = 0; i < engines.size(); ++i) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("lockin %1").arg(i));
+        LockinEngine *engine = new LockinEngine(i, engines[i]);
+        engine->moveToThread(thread);
+        connect(engine, SIGNAL(started(int,bool)), this, SIGNAL(started(int,bool)));
+        connect(engine, SIGNAL(newMeasure(int,LockinMeasure)), this, SIGNAL(newMeasure(int,LockinMeasure)));
+        thread->start();
+        QMetaObject::invokeMethod(engine, "start", Qt::QueuedConnection);
+
+        _threads << thread;
+        _engines << engine;
+    }
+}
+
+void LockinGroup::stop()
+{
+    for (int i = 0; i < _engines.size(); ++i) {
+        QMetaObject::invokeMethod(_engines[i], "stop", Qt::BlockingQueuedConnection);
+        _threads[i]->quit();
+        _threads[i]->wait();
+        // the thread is finished, the engine can be deleted from here
+        delete _engines[i];
+        delete _threads[i];
+    }
+    _engines.clear();
+    _threads.clear();
+}
+
+bool LockinGroup::isRunning() const
+{
+    return !_engines.isEmpty();
+}
+
+void LockinGroup::setIntegrationTime(qreal integrationTime)
+{
+    foreach (LockinEngine *engine, _engines)
+        QMetaObject::invokeMethod(engine, "setIntegrationTime", Qt::QueuedConnection, Q_ARG(qreal, integrationTime));
+}
+
+void LockinGroup::setExtraIntegrationTimes(const QVector<qreal> &integrationTimes)
+{
+    foreach (LockinEngine *engine, _engines)
+        QMetaObject::invokeMethod(engine, "setExtraIntegrationTimes", Qt::QueuedConnection,
+                                  Q_ARG(QVector<qreal>, integrationTimes));
+}
+
+void LockinGroup::setOutputPeriod(qreal outputPeriod)
+{
+    foreach (LockinEngine *engine, _engines)
+        QMetaObject::invokeMethod(engine, "setOutputPeriod", Qt::QueuedConnection, Q_ARG(qreal, outputPeriod));
+}
+
+int LockinGroup::size() const
+{
+    return _engines.size();
+}
+
+QString LockinGroup::deviceName(int engine) const
+{
+    return _engines[engine]->settings().device.deviceName();
+}
+
+LockinStats LockinGroup::stats(int engine) const
+{
+    return _engines[engine]->stats();
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef LOCKINGROUP_HPP
+#define LOCKINGROUP_HPP
+
+#include <QObject>
+#include <QList>
+#include <QAudioDeviceInfo>
+#include "lockin.hh"
+
+class QThread;
+
+/* Several lockins measuring at the same time, one per audio device
+ *
+ * Each engine owns a Lockin and its QAudioInput and lives into its own thread :
+ * the capture and the processing of a device never wait on another device nor on the GUI.
+ * The outputs come back through queued signals tagged with the index of the engine,
+ * the counters of every engine are read with stats() from any thread.
+ */
+
+struct LockinEngineSettings {
+    QAudioDeviceInfo device;
+    QAudioFormat format;
+    qreal integrationTime; // [s]
+    QVector<qreal> extraIntegrationTimes;
+    qreal outputPeriod; // [s]
+    bool invertLR;
+    bool systemClock; // see Lockin::setSystemClockTimestamps
+};
+
+// lives into the thread of its engine
+class LockinEngine : public QObject {
+    Q_OBJECT
+public:
+    LockinEngine(int index, const LockinEngineSettings &settings);
+
+    const LockinEngineSettings &settings() const;
+    LockinStats stats() const; // any thread
+
+public slots:
+    void start();
+    void stop();
+    // see Lockin, applied while running
+    void setIntegrationTime(qreal integrationTime);
+    void setExtraIntegrationTimes(const QVector<qreal> &integrationTimes);
+    void setOutputPeriod(qreal outputPeriod);
+
+signals:
+    void started(int index, bool ok);
+    void newMeasure(int index, const LockinMeasure &measure);
+
+private slots:
+    void forward(const LockinMeasure &measure);
+
+private:
+    int _index;
+    LockinEngineSettings _settings;
+    Lockin *_lockin; // child, moved with the engine
+};
+
+class LockinGroup : public QObject {
+    Q_OBJECT
+public:
+    explicit LockinGroup(QObject *parent = 0);
+    ~LockinGroup();
+
+    // asynchronous, every engine answers with started()
+    void start(const QList<LockinEngineSettings> &engines);
+    void stop(); // stops the devices and waits for the threads
+    bool isRunning() const;
+
+    // forwarded to every engine through its thread
+    void setIntegrationTime(qreal integrationTime);
+    void setExtraIntegrationTimes(const QVector<qreal> &integrationTimes);
+    void setOutputPeriod(qreal outputPeriod);
+
+    int size() const;
+    QString deviceName(int engine) const;
+    LockinStats stats(int engine) const;
+
+signals:
+    void started(int engine, bool ok);
+    void newMeasure(int engine, const LockinMeasure &measure);
+
+private:
+    QList<QThread *> _threads;
+    QList<LockinEngine *> _engines;
+};
+
+#endif // LOCKINGROUP_HPP
@@ -0,0 +1,228 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "lodhistory.hh"
+#include <cmath>
+
+static LodBucket emptyBucket()
+{
+    LodBucket b;
+    b.tFirst = 0.0;
+    b.tLast = 0.0;
+    b.min = INFINITY;
+    b.max = -INFINITY;
+    b.sum = 0.0;
+    b.count = 0;
+    return b;
+}
+
+LodHistory::LodHistory(int capacity) :
+    _capacity(qMax(2, capacity & ~1)) // even : two buckets of a level make one of the next level
+{
+    clear();
+}
+
+void LodHistory::clear()
+{
+    _size = 0;
+    _levels.clear();
+    addLevel();
+}
+
+void LodHistory::merge(LodBucket &bucket, const LodBucket &other)
+{
+    if (other.count == 0)
+        return;
+    if (bucket.count == 0) {
+        bucket = other;
+        return;
+    }
+
+    bucket.tFirst = qMin(bucket.tFirst, other.tFirst);
+    bucket.tLast = qMax(bucket.tLast, other.tLast);
+    bucket.min = qMin(bucket.min, other.min);
+    bucket.max = qMax(bucket.max, other.max);
+    bucket.sum += other.sum;
+    bucket.count += other.count;
+}
+
+const LodBucket &LodHistory::bucket(int level, qint64 j) const
+{
+    return _levels[level].ring[int(j % _capacity)];
+}
+
+qint64 LodHistory::oldest(int level) const
+{
+    const Level &l = _levels[level];
+    return qMax(l.first, l.closed - _capacity);
+}
+
+qint64 LodHistory::lowerBound(int level, qreal t) const
+{
+    qint64 lo = oldest(level);
+    qint64 hi = _levels[level].closed;
+    while (lo < hi) {
+        qint64 mid = lo + (hi - lo) / 2;
+        if (bucket(level, mid).tLast < t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// the new top level is built from the level below, still complete
+void LodHistory::addLevel()
+{
+    Level up;
+    up.ring.resize(_capacity);
+    up.closed = 0;
+    up.first = 0;
+    up.pending = emptyBucket();
+
+    if (!_levels.isEmpty()) {
+        const int k = _levels.size() - 1;
+        const Level &low = _levels[k];
+        Q_ASSERT(oldest(k) == 0);
+
+        for (qint64 j = 0; j + 1 < low.closed; j += 2) {
+            LodBucket b = bucket(k, j);
+            merge(b, bucket(k, j + 1));
+            up.ring[int(up.closed++)] = b;
+        }
+        if (low.closed % 2 == 1)
+            up.pending = bucket(k, low.closed - 1);
+        merge(up.pending, low.pending);
+    }
+
+    _levels << up;
+}
+
+void LodHistory::append(qreal t, qreal y)
+{
+    LodBucket point;
+    point.tFirst = t;
+    point.tLast = t;
+    point.min = y;
+    point.max = y;
+    point.sum = y;
+    point.count = 1;
+
+    for (int k = 0; k < _levels.size(); ++k) {
+        Level &l = _levels[k];
+        merge(l.pending, point);
+        if (l.pending.count == qint64(1) << k) {
+            l.ring[int(l.closed % _capacity)] = l.pending;
+            l.closed++;
+            l.pending = emptyBucket();
+        }
+    }
+    _size++;
+
+    // the top level is about to forget its first bucket
+    if (_levels.last().closed == _capacity)
+        addLevel();
+}
+
+bool LodHistory::removeFrom(qreal t)
+{
+    // the level 0 is made of the points
+    const qint64 c = lowerBound(0, t);
+    if (c == _size)
+        return true;
+    if (c == oldest(0) && c > 0)
+        return false; // older points are lost, we don't know which are before t
+
+    // the pending bucket of each level is rebuilt from the last closed bucket of the level below
+    for (int k = 1; k < _levels.size(); ++k) {
+        if ((c >> (k - 1)) & 1) {
+            if ((c >> (k - 1)) - 1 < oldest(k - 1))
+                return false;
+        }
+    }
+
+    LodBucket pending = emptyBucket();
+    for (int k = 0; k < _levels.size(); ++k) {
+        Level &l = _levels[k];
+        if (k > 0 && ((c >> (k - 1)) & 1))
+            merge(pending, bucket(k - 1, (c >> (k - 1)) - 1));
+
+        // the ring positions of the removed buckets will be overwritten
+        l.first = qMax(l.first, l.closed - _capacity);
+        l.closed = c >> k;
+        l.pending = pending;
+    }
+    _size = c;
+
+    return true;
+}
+
+qint64 LodHistory::size() const
+{
+    return _size;
+}
+
+int LodHistory::levels() const
+{
+    return _levels.size();
+}
+
+qint64 LodHistory::memoryBuckets() const
+{
+    return qint64(_levels.size()) * _capacity;
+}
+
+void LodHistory::render(qreal xmin, qreal xmax, int columns, QList<QPointF> &out) const
+{
+    // the finest level that covers xmin with at most two buckets per column
+    int k = 0;
+    qint64 a = 0, b = 0;
+    for (; k < _levels.size(); ++k) {
+        const qint64 o = oldest(k);
+        a = lowerBound(k, xmin);
+        b = qMin(_levels[k].closed, lowerBound(k, xmax) + 1);
+
+        const bool covers = o == 0 || bucket(k, o).tFirst <= xmin;
+        if ((covers && b - a <= 2 * qint64(columns)) || k == _levels.size() - 1)
+            break;
+    }
+
+    // one more bucket on each side to draw the lines up to the borders
+    a = qMax(oldest(k), a - 1);
+    b = qMin(_levels[k].closed, b + 1);
+
+    auto draw = [&](const LodBucket &bucket) {
+        if (bucket.count == 1) {
+            out << QPointF(bucket.tFirst, bucket.min);
+        } else {
+            const qreal t = 0.5 * (bucket.tFirst + bucket.tLast);
+            out << QPointF(t, bucket.min) << QPointF(t, bucket.max);
+        }
+    };
+
+    for (qint64 j = a; j < b; ++j)
+        draw(bucket(k, j));
+    if (_levels[k].pending.count > 0 && b == _levels[k].closed)
+        draw(_levels[k].pending);
+}
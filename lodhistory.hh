@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef LODHISTORY_HPP
+#define LODHISTORY_HPP
+
+#include <QVector>
+#include <QList>
+#include <QPointF>
+
+/* History of a curve in levels of detail
+ *
+ * The level k is made of buckets of 2^k consecutive points (first and last time, min, max, mean).
+ * Each level keeps only its last capacity buckets in a ring : the level 0 holds the last raw points
+ * and a new level is added each time the top level is full, the whole history stays covered
+ * with a memory of capacity * log2(points / capacity) buckets.
+ *
+ * render() picks the finest level that covers the visible range with about as many buckets as pixels.
+ */
+
+struct LodBucket {
+    qreal tFirst;
+    qreal tLast;
+    qreal min;
+    qreal max;
+    qreal sum;
+    qint64 count; // points in the bucket
+};
+
+class LodHistory
+{
+public:
+    explicit LodHistory(int capacity = 4096); // buckets per level
+    void clear();
+
+    void append(qreal t, qreal y); // t must not decrease
+    // remove the points at t and after, only if they are among the last raw points
+    bool removeFrom(qreal t);
+
+    qint64 size() const; // points appended
+    int levels() const;
+    qint64 memoryBuckets() const; // buckets stored in all the levels
+
+    // about columns buckets of [xmin, xmax] drawn as their min and max (or the point if alone)
+    void render(qreal xmin, qreal xmax, int columns, QList<QPointF> &out) const;
+
+private:
+    struct Level {
+        QVector<LodBucket> ring; // closed bucket j at j % capacity
+        qint64 closed; // buckets closed since the start
+        qint64 first; // older buckets are lost (overwritten after removeFrom)
+        LodBucket pending; // the points after the last closed bucket
+    };
+
+    static void merge(LodBucket &bucket, const LodBucket &other);
+    const LodBucket &bucket(int level, qint64 j) const;
+    qint64 oldest(int level) const; // first closed bucket still in the ring
+    qint64 lowerBound(int level, qreal t) const; // first closed bucket with tLast >= t
+    void addLevel();
+
+    int _capacity;
+    qint64 _size;
+    QVector<Level> _levels;
+};
+
+#endif // LODHISTORY_HPP
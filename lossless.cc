@@ -0,0 +1,634 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "lossless.hh"
+#include <QDataStream>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+
+static const int maxOrder = 4; // fixed predictors of order 0 to 4
+static const int verbatimCode = 7;
+static const int riceEscape = 24; // quotients from this value are stored raw on 64 bits
+static const int maxRiceParameter = 31;
+
+namespace {
+
+class BitWriter
+{
+public:
+    explicit BitWriter(QByteArray &out) : _out(out), _acc(0), _n(0) {}
+
+    void put(quint32 value, int bits) // bits <= 32
+    {
+        if (bits == 0)
+            return;
+        _acc = (_acc << bits) | (quint64(value) & ((quint64(1) << bits) - 1));
+        _n += bits;
+        while (_n >= 8) {
+            _n -= 8;
+            _out.append(char(_acc >> _n));
+        }
+    }
+
+    void put64(quint64 value)
+    {
+        put(quint32(value >> 32), 32);
+        put(quint32(value), 32);
+    }
+
+    void flush()
+    {
+        if (_n > 0)
+            put(0, 8 - _n);
+    }
+
+private:
+    QByteArray &_out;
+    quint64 _acc;
+    int _n;
+};
+
+class BitReader
+{
+public:
+    BitReader(const char *data, qint64 len) :
+        _data(reinterpret_cast<const uchar *>(data)), _len(len), _pos(0), _acc(0), _n(0), _error(false) {}
+
+    quint32 get(int bits) // bits <= 32
+    {
+        if (bits == 0)
+            return 0;
+        while (_n < bits) {
+            if (_pos >= _len) {
+                _error = true;
+                return 0;
+            }
+            _acc = (_acc << 8) | _data[_pos++];
+            _n += 8;
+        }
+        _n -= bits;
+        return quint32((_acc >> _n) & ((quint64(1) << bits) - 1));
+    }
+
+    quint64 get64()
+    {
+        quint64 hi = get(32);
+        return (hi << 32) | get(32);
+    }
+
+    bool error() const { return _error; }
+
+private:
+    const uchar *_data;
+    qint64 _len;
+    qint64 _pos;
+    quint64 _acc;
+    int _n;
+    bool _error;
+};
+
+} // namespace
+
+static inline quint64 zigzag(qint64 r)
+{
+    return (quint64(r) << 1) ^ quint64(r >> 63);
+}
+
+static inline qint64 unzigzag(quint64 u)
+{
+    return qint64(u >> 1) ^ -qint64(u & 1);
+}
+
+static inline qint32 signExtend(quint32 v, int bits)
+{
+    return qint32(v << (32 - bits)) >> (32 - bits);
+}
+
+// fixed polynomial predictors, x[i - order .. i - 1] must exist
+static inline qint64 predict(const qint32 *x, int i, int order)
+{
+    switch (order) {
+    case 1: return qint64(x[i-1]);
+    case 2: return 2 * qint64(x[i-1]) - qint64(x[i-2]);
+    case 3: return 3 * qint64(x[i-1]) - 3 * qint64(x[i-2]) + qint64(x[i-3]);
+    case 4: return 4 * qint64(x[i-1]) - 6 * qint64(x[i-2]) + 4 * qint64(x[i-3]) - qint64(x[i-4]);
+    }
+    return 0;
+}
+
+static qint64 riceBits(const quint64 *u, int n, int k)
+{
+    qint64 total = 0;
+    for (int i = 0; i < n; ++i) {
+        quint64 q = u[i] >> k;
+        total += q < quint64(riceEscape) ? qint64(q) + 1 + k : riceEscape + 64;
+    }
+    return total;
+}
+
+static int riceParameter(const quint64 *u, int n)
+{
+    if (n == 0)
+        return 0;
+
+    long double mean = 0;
+    for (int i = 0; i < n; ++i)
+        mean += u[i];
+    mean /= n;
+
+    int k0 = 0;
+    while (k0 < maxRiceParameter && (long double)(quint64(1) << (k0 + 1)) <= mean)
+        k0++;
+
+    int best = k0;
+    qint64 bestBits = riceBits(u, n, k0);
+    for (int k = qMax(0, k0 - 1); k <= qMin(maxRiceParameter, k0 + 1); ++k) {
+        qint64 b = riceBits(u, n, k);
+        if (b < bestBits) {
+            bestBits = b;
+            best = k;
+        }
+    }
+    return best;
+}
+
+void encodeLosslessBlock(const qint32 *samples, int frames, int channels, int bits, QByteArray &out)
+{
+    out.clear();
+    BitWriter w(out);
+
+    QVector<qint32> x(frames);
+    QVector<quint64> u(frames);
+
+    for (int c = 0; c < channels; ++c) {
+        for (int i = 0; i < frames; ++i)
+            x[i] = samples[i * channels + c];
+
+        // "wasted bits" : zeros at the bottom of every sample (e.g. 24 bits converter in 32 bits samples)
+        quint32 any = 0;
+        for (int i = 0; i < frames; ++i)
+            any |= quint32(x[i]);
+        int shift = 0;
+        while (any != 0 && shift < bits - 1 && (any & (quint32(1) << shift)) == 0)
+            shift++;
+        for (int i = 0; i < frames; ++i)
+            x[i] >>= shift;
+        const int b = bits - shift;
+        w.put(shift, 5);
+
+        // choose the predictor with the smallest residuals
+        int order = 0;
+        qint64 bestSum = -1;
+        for (int o = 0; o <= qMin(maxOrder, frames); ++o) {
+            qint64 sum = 0;
+            for (int i = maxOrder; i < frames; ++i)
+                sum += qAbs(qint64(x[i]) - predict(x.constData(), i, o));
+            if (bestSum < 0 || sum < bestSum) {
+                bestSum = sum;
+                order = o;
+            }
+        }
+
+        const int n = frames - order;
+        for (int i = order; i < frames; ++i)
+            u[i - order] = zigzag(qint64(x[i]) - predict(x.constData(), i, order));
+
+        const int k = riceParameter(u.constData(), n);
+        const qint64 codedBits = qint64(order) * b + 5 + riceBits(u.constData(), n, k);
+
+        if (codedBits >= qint64(frames) * b) {
+            w.put(verbatimCode, 3);
+            for (int i = 0; i < frames; ++i)
+                w.put(quint32(x[i]), b);
+            continue;
+        }
+
+        w.put(order, 3);
+        for (int i = 0; i < order; ++i)
+            w.put(quint32(x[i]), b);
+        w.put(k, 5);
+        for (int i = 0; i < n; ++i) {
+            quint64 q = u[i] >> k;
+            if (q < quint64(riceEscape)) {
+                w.put((quint32(1) << (q + 1)) - 2, int(q) + 1); // q ones and a zero
+                w.put(quint32(u[i]), k);
+            } else {
+                w.put((quint32(1) << riceEscape) - 1, riceEscape);
+                w.put64(u[i]);
+            }
+        }
+    }
+
+    w.flush();
+}
+
+bool decodeLosslessBlock(const char *data, qint64 len, int frames, int channels, int bits, qint32 *samples)
+{
+    BitReader r(data, len);
+    QVector<qint32> x(frames);
+
+    for (int c = 0; c < channels; ++c) {
+        const int shift = r.get(5);
+        const int b = bits - shift;
+        const int code = r.get(3);
+
+        if (b <= 0) {
+            return false;
+        } else if (code == verbatimCode) {
+            for (int i = 0; i < frames; ++i)
+                x[i] = signExtend(r.get(b), b);
+        } else if (code <= maxOrder && code <= frames) {
+            const int order = code;
+            for (int i = 0; i < order; ++i)
+                x[i] = signExtend(r.get(b), b);
+            const int k = r.get(5);
+            for (int i = order; i < frames && !r.error(); ++i) {
+                int q = 0;
+                while (q < riceEscape && r.get(1) == 1)
+                    q++;
+                quint64 u = q == riceEscape ? r.get64() : (quint64(q) << k) | r.get(k);
+                x[i] = qint32(unzigzag(u) + predict(x.constData(), i, order));
+            }
+        } else {
+            return false;
+        }
+
+        if (r.error())
+            return false;
+
+        for (int i = 0; i < frames; ++i)
+            samples[i * channels + c] = qint32(quint32(x[i]) << shift);
+    }
+
+    return true;
+}
+
+void wavToSamples(const char *data, qint64 count, const QAudioFormat &format, qint32 *samples)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    switch (format.sampleSize()) {
+    case 8:
+        for (qint64 i = 0; i < count; ++i)
+            samples[i] = qint32(p[i]) - 128;
+        break;
+    case 16:
+        for (qint64 i = 0; i < count; ++i)
+            samples[i] = qFromLittleEndian<qint16>(p + 2 * i);
+        break;
+    case 32:
+        for (qint64 i = 0; i < count; ++i)
+            samples[i] = qFromLittleEndian<qint32>(p + 4 * i);
+        break;
+    }
+}
+
+void samplesToWav(const qint32 *samples, qint64 count, const QAudioFormat &format, char *data)
+{
+    uchar *p = reinterpret_cast<uchar *>(data);
+    switch (format.sampleSize()) {
+    case 8:
+        for (qint64 i = 0; i < count; ++i)
+            p[i] = uchar(samples[i] + 128);
+        break;
+    case 16:
+        for (qint64 i = 0; i < count; ++i)
+            qToLittleEndian<qint16>(qint16(samples[i]), p + 2 * i);
+        break;
+    case 32:
+        for (qint64 i = 0; i < count; ++i)
+            qToLittleEndian<qint32>(samples[i], p + 4 * i);
+        break;
+    }
+}
+
+// container
+
+static const char lkfMagic[8] = {'L', 'O', 'C', 'K', 'L', 'K', 'F', '\0'};
+static const quint32 lkfVersion = 1;
+static const int lkfHeaderSize = 64;
+
+LosslessWriter::LosslessWriter()
+{
+    _blockFrames = 4096;
+    _frames = 0;
+    _error = false;
+}
+
+LosslessWriter::~LosslessWriter()
+{
+    close();
+}
+
+bool LosslessWriter::open(const QString &path, const QAudioFormat &format, int blockFrames)
+{
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << __FUNCTION__ << ": cannot open" << path;
+        return false;
+    }
+
+    _format = format;
+    _blockFrames = blockFrames;
+    _pending.clear();
+    _index.clear();
+    _frames = 0;
+    _error = false;
+    _samples.resize(blockFrames * format.channelCount());
+
+    return writeHeader(0, 0);
+}
+
+bool LosslessWriter::writeHeader(quint64 frames, quint64 indexOffset)
+{
+    QByteArray h;
+    QDataStream out(&h, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(lkfMagic, sizeof lkfMagic);
+    out << lkfVersion << quint32(lkfHeaderSize) << qint32(_format.sampleRate())
+        << quint16(_format.channelCount()) << quint16(_format.sampleSize())
+        << quint16(_format.sampleType()) << quint16(0)
+        << quint32(_blockFrames) << frames << indexOffset;
+    h.append(QByteArray(lkfHeaderSize - h.size(), 0));
+
+    _file.seek(0);
+    return writeData(h);
+}
+
+// the first error is reported, nothing is written after it : the next blocks would not match the index
+bool LosslessWriter::writeData(const QByteArray &data)
+{
+    if (_error)
+        return false;
+    if (_file.write(data) != data.size()) {
+        qDebug() << __FUNCTION__ << ": write error" << _file.fileName() << _file.errorString();
+        _error = true;
+        return false;
+    }
+    return true;
+}
+
+void LosslessWriter::write(const char *data, qint64 len)
+{
+    const qint64 blockBytes = qint64(_blockFrames) * _format.bytesPerFrame();
+    qint64 offset = 0;
+
+    // complete the pending block first
+    if (!_pending.isEmpty()) {
+        qint64 n = qMin(len, blockBytes - _pending.size());
+        _pending.append(data, n);
+        offset = n;
+        if (_pending.size() == blockBytes) {
+            writeBlock(_pending.constData(), _blockFrames);
+            _pending.clear();
+        }
+    }
+
+    for (; len - offset >= blockBytes; offset += blockBytes)
+        writeBlock(data + offset, _blockFrames);
+
+    _pending.append(data + offset, len - offset);
+}
+
+void LosslessWriter::writeBlock(const char *data, int frames)
+{
+    if (_error)
+        return;
+
+    const int channels = _format.channelCount();
+    wavToSamples(data, qint64(frames) * channels, _format, _samples.data());
+    encodeLosslessBlock(_samples.constData(), frames, channels, _format.sampleSize(), _payload);
+
+    _index << qMakePair(_frames, quint64(_file.pos()));
+    _frames += frames;
+
+    uchar h[8];
+    qToLittleEndian<quint32>(frames, h);
+    qToLittleEndian<quint32>(_payload.size(), h + 4);
+    if (writeData(QByteArray::fromRawData(reinterpret_cast<const char *>(h), 8)))
+        writeData(_payload);
+}
+
+void LosslessWriter::close()
+{
+    if (!_file.isOpen())
+        return;
+
+    if (!_pending.isEmpty()) {
+        writeBlock(_pending.constData(), _pending.size() / _format.bytesPerFrame());
+        _pending.clear();
+    }
+
+    quint64 indexOffset = _file.pos();
+    QByteArray index;
+    QDataStream out(&index, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint64(_index.size());
+    for (int i = 0; i < _index.size(); ++i)
+        out << _index[i].first << _index[i].second;
+    // without the index and the header the reader rebuilds the index from the blocks
+    if (writeData(index))
+        writeHeader(_frames, indexOffset);
+    if (!_file.flush() && !_error) {
+        qDebug() << __FUNCTION__ << ": write error" << _file.fileName() << _file.errorString();
+        _error = true;
+    }
+    _file.close();
+}
+
+bool LosslessWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool LosslessWriter::hasError() const
+{
+    return _error;
+}
+
+LosslessReader::LosslessReader()
+{
+    _frames = 0;
+    _block = -1;
+    _position = 0;
+}
+
+bool LosslessReader::open(const QString &path)
+{
+    close();
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        qDebug() << __FUNCTION__ << ": cannot open" << path;
+        return false;
+    }
+
+    QByteArray h = _file.read(lkfHeaderSize);
+    if (h.size() != lkfHeaderSize || !h.startsWith(QByteArray(lkfMagic, sizeof lkfMagic))) {
+        qDebug() << __FUNCTION__ << ": not a lkf file" << path;
+        _file.close();
+        return false;
+    }
+
+    QDataStream in(h);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.skipRawData(sizeof lkfMagic);
+    quint32 version, headerSize, blockFrames;
+    qint32 rate;
+    quint16 channels, sampleSize, sampleType, reserved;
+    quint64 frames, indexOffset;
+    in >> version >> headerSize >> rate >> channels >> sampleSize >> sampleType >> reserved
+       >> blockFrames >> frames >> indexOffset;
+
+    if (version != lkfVersion) {
+        qDebug() << __FUNCTION__ << ": unsupported version" << version;
+        _file.close();
+        return false;
+    }
+
+    _format.setCodec("audio/pcm");
+    _format.setSampleRate(rate);
+    _format.setChannelCount(channels);
+    _format.setSampleSize(sampleSize);
+    _format.setSampleType(QAudioFormat::SampleType(sampleType));
+    _format.setByteOrder(QAudioFormat::LittleEndian);
+
+    _index.clear();
+    if (indexOffset != 0 && _file.seek(indexOffset)) {
+        QDataStream idx(&_file);
+        idx.setByteOrder(QDataStream::LittleEndian);
+        quint64 count;
+        idx >> count;
+        for (quint64 i = 0; i < count && idx.status() == QDataStream::Ok; ++i) {
+            quint64 first, offset;
+            idx >> first >> offset;
+            _index << qMakePair(first, offset);
+        }
+        _frames = frames;
+    } else {
+        // no index : the recording was interrupted, walk the complete blocks
+        qint64 pos = headerSize;
+        _frames = 0;
+        while (_file.seek(pos)) {
+            QByteArray b = _file.read(8);
+            if (b.size() != 8)
+                break;
+            quint32 n = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(b.constData()));
+            quint32 len = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(b.constData()) + 4);
+            if (pos + 8 + len > _file.size())
+                break;
+            _index << qMakePair(quint64(_frames), quint64(pos));
+            _frames += n;
+            pos += 8 + len;
+        }
+    }
+
+    _block = -1;
+    return seek(0);
+}
+
+void LosslessReader::close()
+{
+    _file.close();
+    _index.clear();
+    _frames = 0;
+    _block = -1;
+    _position = 0;
+}
+
+const QAudioFormat &LosslessReader::format() const
+{
+    return _format;
+}
+
+qint64 LosslessReader::frames() const
+{
+    return _frames;
+}
+
+qint64 LosslessReader::position() const
+{
+    return _position;
+}
+
+bool LosslessReader::seek(qint64 frame)
+{
+    if (frame < 0 || frame > _frames)
+        return false;
+    _position = frame;
+    return true;
+}
+
+bool LosslessReader::loadBlock(int block)
+{
+    if (block == _block)
+        return true;
+
+    if (!_file.seek(_index[block].second))
+        return false;
+
+    QByteArray b = _file.read(8);
+    if (b.size() != 8)
+        return false;
+    const quint32 n = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(b.constData()));
+    const quint32 len = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(b.constData()) + 4);
+    QByteArray payload = _file.read(len);
+
+    const int channels = _format.channelCount();
+    _samples.resize(n * channels);
+    if (!decodeLosslessBlock(payload.constData(), payload.size(), n, channels, _format.sampleSize(), _samples.data())) {
+        qDebug() << __FUNCTION__ << ": corrupted block" << block;
+        _block = -1;
+        return false;
+    }
+
+    _decoded.resize(n * _format.bytesPerFrame());
+    samplesToWav(_samples.constData(), _samples.size(), _format, _decoded.data());
+    _block = block;
+    return true;
+}
+
+QByteArray LosslessReader::read(qint64 frames)
+{
+    QByteArray out;
+    const int bpf = _format.bytesPerFrame();
+
+    while (frames > 0 && _position < _frames) {
+        // last block starting at or before the position
+        auto it = std::upper_bound(_index.constBegin(), _index.constEnd(), quint64(_position),
+                                   [](quint64 f, const QPair<quint64, quint64> &e) { return f < e.first; });
+        int block = int(it - _index.constBegin()) - 1;
+        if (block < 0 || !loadBlock(block))
+            break;
+
+        qint64 offset = _position - qint64(_index[block].first);
+        qint64 n = qMin(frames, qint64(_decoded.size() / bpf) - offset);
+        if (n <= 0)
+            break;
+        out.append(_decoded.constData() + offset * bpf, n * bpf);
+        _position += n;
+        frames -= n;
+    }
+
+    return out;
+}
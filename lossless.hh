@@ -0,0 +1,115 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef LOSSLESS_HPP
+#define LOSSLESS_HPP
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+#include <QPair>
+
+/* Lossless compression of the raw stream (.lkf), in the spirit of FLAC
+ *
+ * The samples are cut into blocks of blockFrames frames. In each block every channel
+ * is predicted by the best fixed polynomial predictor (order 0 to 4) and the residuals
+ * are Rice coded. Low bits always zero (e.g. 24 bits converter in 32 bits samples) are
+ * removed first. A channel that does not compress is stored verbatim.
+ * Float samples are coded through their bit pattern (lossless but less efficient).
+ *
+ * File : [header 64 bytes][block][block]...[index]
+ * block : frames (u32), payload bytes (u32), payload
+ * index : count (u64) then (first frame, file offset) (u64, u64) per block
+ * All the fields are little endian. The header points to the index, without index
+ * (interrupted recording) the reader rebuilds it by walking the blocks.
+ */
+
+// samples : interleaved signed integers (see wavToSamples)
+void encodeLosslessBlock(const qint32 *samples, int frames, int channels, int bits, QByteArray &out);
+bool decodeLosslessBlock(const char *data, qint64 len, int frames, int channels, int bits, qint32 *samples);
+
+// bytes in wavFormat() <-> signed integers
+void wavToSamples(const char *data, qint64 count, const QAudioFormat &format, qint32 *samples);
+void samplesToWav(const qint32 *samples, qint64 count, const QAudioFormat &format, char *data);
+
+class LosslessWriter
+{
+public:
+    LosslessWriter();
+    ~LosslessWriter();
+
+    // format must be a wavFormat()
+    bool open(const QString &path, const QAudioFormat &format, int blockFrames = 4096);
+    void write(const char *data, qint64 len); // complete frames in format
+    void close(); // write the last block and the index
+    bool isOpen() const;
+    // a write has failed (disk full...), the blocks after it are not written, reset by open()
+    bool hasError() const;
+
+private:
+    void writeBlock(const char *data, int frames);
+    bool writeHeader(quint64 frames, quint64 indexOffset);
+    bool writeData(const QByteArray &data);
+
+    QFile _file;
+    QAudioFormat _format;
+    int _blockFrames;
+    QByteArray _pending; // less than one block
+    QVector<qint32> _samples;
+    QByteArray _payload;
+    QVector<QPair<quint64, quint64>> _index; // (first frame, offset)
+    quint64 _frames;
+    bool _error;
+};
+
+class LosslessReader
+{
+public:
+    LosslessReader();
+
+    bool open(const QString &path);
+    void close();
+
+    const QAudioFormat &format() const; // a wavFormat()
+    qint64 frames() const;
+    qint64 position() const;
+
+    bool seek(qint64 frame); // any frame thanks to the block index
+    QByteArray read(qint64 frames); // wav samples, less at the end of the file
+
+private:
+    bool loadBlock(int block);
+
+    QFile _file;
+    QAudioFormat _format;
+    qint64 _frames;
+    QVector<QPair<quint64, quint64>> _index; // (first frame, offset)
+
+    int _block; // decoded block, -1 if none
+    QByteArray _decoded;
+    QVector<qint32> _samples;
+    qint64 _position; // frame
+};
+
+#endif // LOSSLESS_HPP
@@ -0,0 +1,215 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "measurelog.hh"
+#include <QDebug>
+#include <cstring>
+
+static const char logMagic[8] = {'L', 'O', 'C', 'K', 'L', 'O', 'G', '\0'};
+static const quint32 logVersion = 1;
+static const quint32 logByteOrderMark = 0x01020304;
+
+MeasureLogWriter::MeasureLogWriter()
+{
+    _integrationTime = 0.0;
+    _error = false;
+}
+
+MeasureLogWriter::~MeasureLogWriter()
+{
+    close();
+}
+
+bool MeasureLogWriter::open(const QString &path, int sampleRate, qreal integrationTime, qreal outputPeriod)
+{
+    _error = false;
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << __FUNCTION__ << ": cannot open" << path;
+        return false;
+    }
+
+    memset(&_header, 0, sizeof _header);
+    memcpy(_header.magic, logMagic, sizeof logMagic);
+    _header.version = logVersion;
+    _header.byteOrderMark = logByteOrderMark;
+    _header.headerSize = sizeof(MeasureLogHeader);
+    _header.recordSize = sizeof(MeasureLogRecord);
+    _header.sampleRate = sampleRate;
+    _header.integrationTime = integrationTime;
+    _integrationTime = integrationTime;
+    _header.referenceFrequency = 0.0;
+    _header.outputPeriod = outputPeriod;
+
+    return _file.write(reinterpret_cast<const char *>(&_header), sizeof _header) == sizeof _header;
+}
+
+void MeasureLogWriter::append(const LockinMeasure &measure)
+{
+    MeasureLogRecord record;
+    record.sampleIndex = measure.sampleIndex;
+    record.x = measure.value.real();
+    record.y = measure.value.imag();
+    record.r = std::abs(measure.value);
+    record.flags = measure.flags;
+    record.integrationTime = float(_integrationTime);
+
+    // after a short write the next records would be misaligned : stop at the first error
+    if (_error)
+        return;
+    if (_file.write(reinterpret_cast<const char *>(&record), sizeof record) != sizeof record) {
+        qDebug() << __FUNCTION__ << ": write error" << _file.fileName() << _file.errorString();
+        _error = true;
+    }
+}
+
+void MeasureLogWriter::setIntegrationTime(qreal integrationTime)
+{
+    _integrationTime = integrationTime;
+}
+
+void MeasureLogWriter::setReferenceFrequency(qreal frequency)
+{
+    _header.referenceFrequency = frequency;
+}
+
+void MeasureLogWriter::close()
+{
+    if (!_file.isOpen())
+        return;
+
+    _file.seek(0);
+    if (_file.write(reinterpret_cast<const char *>(&_header), sizeof _header) != sizeof _header || !_file.flush()) {
+        qDebug() << __FUNCTION__ << ": write error" << _file.fileName() << _file.errorString();
+        _error = true;
+    }
+    _file.close();
+}
+
+bool MeasureLogWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+bool MeasureLogWriter::hasError() const
+{
+    return _error;
+}
+
+MeasureLogReader::MeasureLogReader()
+{
+    _map = nullptr;
+    _size = 0;
+    memset(&_header, 0, sizeof _header);
+}
+
+MeasureLogReader::~MeasureLogReader()
+{
+    close();
+}
+
+bool MeasureLogReader::open(const QString &path)
+{
+    close();
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        qDebug() << __FUNCTION__ << ": cannot open" << path;
+        return false;
+    }
+
+    if (_file.read(reinterpret_cast<char *>(&_header), sizeof _header) != sizeof _header
+            || memcmp(_header.magic, logMagic, sizeof logMagic) != 0) {
+        qDebug() << __FUNCTION__ << ": not a lockin log" << path;
+        _file.close();
+        return false;
+    }
+
+    if (_header.byteOrderMark != logByteOrderMark || _header.version != logVersion
+            || _header.recordSize != sizeof(MeasureLogRecord) || _header.headerSize < sizeof(MeasureLogHeader)) {
+        qDebug() << __FUNCTION__ << ": unsupported log (version, byte order or record size)" << path;
+        _file.close();
+        return false;
+    }
+
+    // the times are sampleIndex / sampleRate
+    if (_header.sampleRate <= 0) {
+        qDebug() << __FUNCTION__ << ": invalid sample rate" << _header.sampleRate << path;
+        _file.close();
+        return false;
+    }
+
+    _size = (_file.size() - _header.headerSize) / _header.recordSize;
+    if (_size > 0) {
+        _map = _file.map(0, _header.headerSize + _size * _header.recordSize);
+        if (_map == nullptr) {
+            qDebug() << __FUNCTION__ << ": cannot map" << path;
+            _file.close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeasureLogReader::close()
+{
+    if (_map != nullptr) {
+        _file.unmap(_map);
+        _map = nullptr;
+    }
+    _size = 0;
+    _file.close();
+}
+
+const MeasureLogHeader &MeasureLogReader::header() const
+{
+    return _header;
+}
+
+qint64 MeasureLogReader::size() const
+{
+    return _size;
+}
+
+const MeasureLogRecord &MeasureLogReader::at(qint64 i) const
+{
+    Q_ASSERT(i >= 0 && i < _size);
+    return records()[i];
+}
+
+const MeasureLogRecord *MeasureLogReader::records() const
+{
+    return reinterpret_cast<const MeasureLogRecord *>(_map + _header.headerSize);
+}
+
+qreal MeasureLogReader::time(qint64 i) const
+{
+    return qreal(at(i).sampleIndex) / qreal(_header.sampleRate);
+}
+
+qreal MeasureLogReader::integrationTime(qint64 i) const
+{
+    const float t = at(i).integrationTime;
+    return t > 0.0f ? qreal(t) : _header.integrationTime;
+}
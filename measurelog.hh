@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef MEASURELOG_HPP
+#define MEASURELOG_HPP
+
+#include <QFile>
+#include "lockin.hh"
+
+/* Binary append-only log of the lockin outputs
+ *
+ * [MeasureLogHeader][MeasureLogRecord][MeasureLogRecord]...
+ *
+ * Fixed size records in the byte order of the machine (checked with byteOrderMark)
+ * so that a reader can map the file and access any record without parsing.
+ * A record cut by a crash at the end of the file is ignored.
+ * The integration time and the output period can change while logging :
+ * the header keeps the values of the start and each record its own integration time.
+ */
+
+struct MeasureLogHeader {
+    char magic[8]; // "LOCKLOG\0"
+    quint32 version;
+    quint32 byteOrderMark; // 0x01020304 written natively
+    quint32 headerSize;
+    quint32 recordSize;
+    qint32 sampleRate; // sampleIndex / sampleRate = time [s]
+    quint32 reserved0;
+    double integrationTime; // [s] at the start
+    double referenceFrequency; // [Hz] mean chopper frequency, 0 if unknown
+    double outputPeriod; // [s] at the start
+    quint64 reserved1;
+};
+
+struct MeasureLogRecord {
+    qint64 sampleIndex; // center of the integration window
+    double x;
+    double y;
+    double r;
+    quint32 flags; // LockinMeasure::Flag
+    float integrationTime; // [s] of this output, 0 in the older logs (see the header)
+};
+
+Q_STATIC_ASSERT(sizeof(MeasureLogHeader) == 64);
+Q_STATIC_ASSERT(sizeof(MeasureLogRecord) == 40);
+
+class MeasureLogWriter
+{
+public:
+    MeasureLogWriter();
+    ~MeasureLogWriter();
+
+    bool open(const QString &path, int sampleRate, qreal integrationTime, qreal outputPeriod);
+    void append(const LockinMeasure &measure);
+    void setIntegrationTime(qreal integrationTime); // of the next records
+    void setReferenceFrequency(qreal frequency); // written into the header by close()
+    void close();
+    bool isOpen() const;
+    // a write has failed (disk full...), the records after it are not written, reset by open()
+    bool hasError() const;
+
+private:
+    QFile _file;
+    MeasureLogHeader _header;
+    qreal _integrationTime;
+    bool _error;
+};
+
+class MeasureLogReader
+{
+public:
+    MeasureLogReader();
+    ~MeasureLogReader();
+
+    bool open(const QString &path); // map the file
+    void close();
+
+    const MeasureLogHeader &header() const;
+    qint64 size() const;
+    const MeasureLogRecord &at(qint64 i) const;
+    const MeasureLogRecord *records() const;
+    qreal time(qint64 i) const; // [s]
+    qreal integrationTime(qint64 i) const; // [s]
+
+private:
+    QFile _file;
+    uchar *_map;
+    MeasureLogHeader _header;
+    qint64 _size;
+};
+
+#endif // MEASURELOG_HPP
@@ -0,0 +1,228 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "measureserver.hh"
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <cstring>
+
+static const char streamMagic[8] = {'L', 'O', 'C', 'K', 'S', 'T', 'R', 'M'};
+static const quint32 streamVersion = 1;
+static const quint32 streamByteOrderMark = 0x01020304;
+
+MeasureServer::MeasureServer(QObject *parent) : QObject(parent)
+{
+    _local = nullptr;
+    _tcp = nullptr;
+    _queueLimit = 64 * 1024;
+    _dropTimeout = 5.0;
+    _sequence = 0;
+    _droppedFrames = 0;
+    _disconnectedClients = 0;
+    _clock.start();
+}
+
+MeasureServer::~MeasureServer()
+{
+    close();
+}
+
+bool MeasureServer::listen(const QString &address)
+{
+    close();
+
+    if (address.startsWith("tcp:")) {
+        bool ok;
+        quint16 port = address.mid(4).toUShort(&ok);
+        if (!ok) {
+            qDebug() << __FUNCTION__ << ": bad port" << address;
+            return false;
+        }
+        _tcp = new QTcpServer(this);
+        if (!_tcp->listen(QHostAddress::LocalHost, port)) {
+            qDebug() << __FUNCTION__ << ": cannot listen" << address << _tcp->errorString();
+            close();
+            return false;
+        }
+        connect(_tcp, SIGNAL(newConnection()), this, SLOT(acceptTcp()));
+    } else {
+        _local = new QLocalServer(this);
+        // a crashed server leaves its socket file behind
+        QLocalServer::removeServer(address);
+        if (!_local->listen(address)) {
+            qDebug() << __FUNCTION__ << ": cannot listen" << address << _local->errorString();
+            close();
+            return false;
+        }
+        connect(_local, SIGNAL(newConnection()), this, SLOT(acceptLocal()));
+    }
+
+    _sequence = 0;
+    _droppedFrames = 0;
+    _disconnectedClients = 0;
+    return true;
+}
+
+void MeasureServer::close()
+{
+    while (!_clients.isEmpty())
+        dropClient(0);
+
+    delete _local;
+    _local = nullptr;
+    delete _tcp;
+    _tcp = nullptr;
+}
+
+bool MeasureServer::isListening() const
+{
+    return _local != nullptr || _tcp != nullptr;
+}
+
+void MeasureServer::setQueueLimit(qint64 bytes)
+{
+    _queueLimit = qMax(qint64(sizeof(MeasureStreamFrame)), bytes);
+}
+
+qint64 MeasureServer::queueLimit() const
+{
+    return _queueLimit;
+}
+
+void MeasureServer::setDropTimeout(qreal seconds)
+{
+    _dropTimeout = seconds;
+}
+
+qreal MeasureServer::dropTimeout() const
+{
+    return _dropTimeout;
+}
+
+MeasureServerStats MeasureServer::stats() const
+{
+    MeasureServerStats s;
+    s.clients = _clients.size();
+    s.frames = qint64(_sequence);
+    s.droppedFrames = _droppedFrames;
+    s.disconnectedClients = _disconnectedClients;
+    return s;
+}
+
+void MeasureServer::publish(const LockinMeasure &measure)
+{
+    MeasureStreamFrame frame;
+    frame.sequence = _sequence++;
+    frame.sampleIndex = measure.sampleIndex;
+    frame.time = measure.time;
+    frame.x = measure.value.real();
+    frame.y = measure.value.imag();
+    frame.systemTimeNs = measure.systemTimeNs;
+    frame.flags = measure.flags;
+    frame.channel = quint32(measure.channel);
+
+    const qint64 now = _clock.nsecsElapsed();
+
+    for (int i = _clients.size() - 1; i >= 0; --i) {
+        Client &c = _clients[i];
+
+        if (c.socket->bytesToWrite() + qint64(sizeof frame) > _queueLimit) {
+            _droppedFrames++;
+            if (c.fullSinceNs < 0)
+                c.fullSinceNs = now;
+            else if (qreal(now - c.fullSinceNs) * 1e-9 > _dropTimeout) {
+                qDebug() << __FUNCTION__ << ": disconnect a slow client";
+                _disconnectedClients++;
+                dropClient(i);
+            }
+            continue;
+        }
+
+        c.fullSinceNs = -1;
+        c.socket->write(reinterpret_cast<const char *>(&frame), sizeof frame);
+    }
+}
+
+void MeasureServer::acceptLocal()
+{
+    while (QLocalSocket *socket = _local->nextPendingConnection()) {
+        connect(socket, SIGNAL(disconnected()), this, SLOT(removeClient()));
+        addClient(socket);
+    }
+}
+
+void MeasureServer::acceptTcp()
+{
+    while (QTcpSocket *socket = _tcp->nextPendingConnection()) {
+        // one frame per output, do not wait to fill a segment
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, SIGNAL(disconnected()), this, SLOT(removeClient()));
+        addClient(socket);
+    }
+}
+
+void MeasureServer::addClient(QIODevice *socket)
+{
+    MeasureStreamHello hello;
+    memset(&hello, 0, sizeof hello);
+    memcpy(hello.magic, streamMagic, sizeof streamMagic);
+    hello.version = streamVersion;
+    hello.byteOrderMark = streamByteOrderMark;
+    hello.helloSize = sizeof(MeasureStreamHello);
+    hello.frameSize = sizeof(MeasureStreamFrame);
+    socket->write(reinterpret_cast<const char *>(&hello), sizeof hello);
+
+    Client c;
+    c.socket = socket;
+    c.fullSinceNs = -1;
+    _clients << c;
+}
+
+void MeasureServer::removeClient()
+{
+    for (int i = 0; i < _clients.size(); ++i) {
+        if (_clients[i].socket == sender()) {
+            _clients.removeAt(i);
+            sender()->deleteLater();
+            return;
+        }
+    }
+}
+
+// abort : a slow client must not be flushed
+void MeasureServer::dropClient(int i)
+{
+    QIODevice *socket = _clients[i].socket;
+    _clients.removeAt(i);
+
+    socket->disconnect(this);
+    if (QLocalSocket *local = qobject_cast<QLocalSocket *>(socket))
+        local->abort();
+    else if (QTcpSocket *tcp = qobject_cast<QTcpSocket *>(socket))
+        tcp->abort();
+    socket->deleteLater();
+}
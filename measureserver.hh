@@ -0,0 +1,126 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef MEASURESERVER_HPP
+#define MEASURESERVER_HPP
+
+#include <QObject>
+#include <QElapsedTimer>
+#include "lockin.hh"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+/* Publishes the outputs of a Lockin to other processes of the host
+ *
+ * [MeasureStreamHello][MeasureStreamFrame][MeasureStreamFrame]...
+ *
+ * Every client receives the hello when it connects, then one fixed size frame per output,
+ * in the byte order of the server (checked with byteOrderMark). The clients never send anything.
+ *
+ * publish() never waits on a client : the frame is appended to the write buffer of each socket.
+ * When the buffer of a client holds more than queueLimit() bytes the frames are dropped for it
+ * (the client sees a hole in the sequence numbers, it is decimated to what it can read),
+ * and a client that stays full for dropTimeout() seconds is disconnected.
+ */
+
+struct MeasureStreamHello {
+    char magic[8]; // "LOCKSTRM"
+    quint32 version;
+    quint32 byteOrderMark; // 0x01020304 written natively
+    quint32 helloSize;
+    quint32 frameSize;
+};
+
+struct MeasureStreamFrame {
+    quint64 sequence; // counted by the server from 0, holes are dropped frames
+    qint64 sampleIndex; // see LockinMeasure
+    double time; // [s]
+    double x;
+    double y;
+    qint64 systemTimeNs; // 0 if disabled
+    quint32 flags; // LockinMeasure::Flag
+    quint32 channel;
+};
+
+Q_STATIC_ASSERT(sizeof(MeasureStreamHello) == 24);
+Q_STATIC_ASSERT(sizeof(MeasureStreamFrame) == 56);
+
+struct MeasureServerStats {
+    int clients; // connected now
+    qint64 frames; // published
+    qint64 droppedFrames; // not sent to a client because its queue was full (all clients)
+    qint64 disconnectedClients; // dropped because too slow
+};
+
+class MeasureServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit MeasureServer(QObject *parent = 0);
+    ~MeasureServer();
+
+    // "name" : local socket (QLocalServer), "tcp:port" : TCP on localhost
+    bool listen(const QString &address);
+    void close();
+    bool isListening() const;
+
+    void setQueueLimit(qint64 bytes); // per client, default 64 kB
+    qint64 queueLimit() const;
+    void setDropTimeout(qreal seconds); // default 5 s
+    qreal dropTimeout() const;
+
+    MeasureServerStats stats() const;
+
+public slots:
+    void publish(const LockinMeasure &measure);
+
+private slots:
+    void acceptLocal();
+    void acceptTcp();
+    void removeClient();
+
+private:
+    struct Client {
+        QIODevice *socket;
+        qint64 fullSinceNs; // -1 when the queue is not full
+    };
+
+    void addClient(QIODevice *socket);
+    void dropClient(int i);
+
+    QLocalServer *_local;
+    QTcpServer *_tcp;
+    QList<Client> _clients;
+    QElapsedTimer _clock;
+
+    qint64 _queueLimit;
+    qreal _dropTimeout;
+    quint64 _sequence;
+    qint64 _droppedFrames;
+    qint64 _disconnectedClients;
+};
+
+#endif // MEASURESERVER_HPP
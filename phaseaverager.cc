@@ -0,0 +1,105 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "phaseaverager.hh"
+#include <cmath>
+
+PhaseAverager::PhaseAverager() :
+    _timeConstant(0.0),
+    _samples(0)
+{
+}
+
+void PhaseAverager::reset(int bins)
+{
+    _sums.fill(0.0, qMax(0, bins));
+    _weights.fill(0.0, qMax(0, bins));
+    _samples = 0;
+}
+
+int PhaseAverager::bins() const
+{
+    return _sums.size();
+}
+
+void PhaseAverager::setTimeConstant(qreal seconds)
+{
+    _timeConstant = qMax(qreal(0.0), seconds);
+}
+
+qreal PhaseAverager::timeConstant() const
+{
+    return _timeConstant;
+}
+
+void PhaseAverager::add(const QVector<QPair<qreal, qreal>> &left_right,
+                        const QVector<std::complex<qreal>> &complex_exp, qreal duration)
+{
+    const int n = _sums.size();
+    if (n == 0)
+        return;
+
+    Q_ASSERT(complex_exp.size() == left_right.size());
+
+    if (_timeConstant > 0.0) {
+        const qreal decay = std::exp(-duration / _timeConstant);
+        for (int b = 0; b < n; ++b) {
+            _sums[b] *= decay;
+            _weights[b] *= decay;
+        }
+    }
+
+    qreal *sums = _sums.data();
+    qreal *weights = _weights.data();
+    const qreal binsPerRadian = qreal(n) / (2.0 * M_PI);
+
+    for (int i = 0; i < left_right.size(); ++i) {
+        const std::complex<qreal> &z = complex_exp[i];
+        if (std::isnan(z.real()) || std::isnan(z.imag()))
+            continue;
+
+        // phase in [0, 2pi), the period starts at the rising edge
+        qreal phase = std::atan2(z.imag(), z.real());
+        if (phase < 0.0)
+            phase += 2.0 * M_PI;
+        const int b = qMin(n - 1, int(phase * binsPerRadian));
+
+        sums[b] += left_right[i].first;
+        weights[b] += 1.0;
+        _samples++;
+    }
+}
+
+QVector<qreal> PhaseAverager::waveform() const
+{
+    QVector<qreal> means(_sums.size());
+    for (int b = 0; b < _sums.size(); ++b)
+        means[b] = _weights[b] > 0.0 ? _sums[b] / _weights[b] : NAN;
+    return means;
+}
+
+qint64 PhaseAverager::samples() const
+{
+    return _samples;
+}
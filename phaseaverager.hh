@@ -0,0 +1,63 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef PHASEAVERAGER_HPP
+#define PHASEAVERAGER_HPP
+
+#include <QVector>
+#include <QPair>
+#include <complex>
+
+/* Average of the left signal by phase of the chopper (boxcar averager)
+ *
+ * Each sample goes into one of N bins of the reference period, given by the phase of sin/cos.
+ * The mean of each bin is the waveform of one period with the noise averaged out.
+ * O(1) per sample, O(N) per block for the exponential forgetting.
+ */
+class PhaseAverager
+{
+public:
+    PhaseAverager();
+
+    void reset(int bins); // forget everything, 0 disables
+    int bins() const;
+    // the older blocks weight exp(-age / timeConstant), 0 : plain average since the reset
+    void setTimeConstant(qreal seconds);
+    qreal timeConstant() const;
+
+    // samples with a NAN reference are skipped, duration of the block [s]
+    void add(const QVector<QPair<qreal, qreal>> &left_right,
+             const QVector<std::complex<qreal>> &complex_exp, qreal duration);
+
+    QVector<qreal> waveform() const; // mean of each bin, NAN if empty
+    qint64 samples() const; // since the reset
+
+private:
+    QVector<qreal> _sums;
+    QVector<qreal> _weights;
+    qreal _timeConstant;
+    qint64 _samples;
+};
+
+#endif // PHASEAVERAGER_HPP
@@ -0,0 +1,173 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "prefixsum.hh"
+#include <cmath>
+
+PrefixSum::PrefixSum()
+{
+    reset(0, 1, 1);
+}
+
+void PrefixSum::reset(qint64 firstSample, int bucket, qint64 capacity)
+{
+    _bucket = qMax(1, bucket);
+    _origin = firstSample;
+    _sums.fill(0.0, int(qMax(qint64(2), capacity)));
+    _counts.fill(0, _sums.size());
+
+    _end = firstSample;
+    _sum = 0.0;
+    _count = 0;
+
+    // boundary 0
+    _boundaries = 0;
+    _oldest = 0;
+    closeBucket();
+}
+
+void PrefixSum::setCapacity(qint64 capacity)
+{
+    capacity = qMax(qint64(2), capacity);
+    if (capacity == _sums.size())
+        return;
+
+    // keep the most recent boundaries that fit
+    const int size = int(capacity);
+    QVector<std::complex<qreal>> sums(size);
+    QVector<qint64> counts(size);
+    const qint64 first = qMax(_oldest, _boundaries - qMin(qint64(_sums.size()), capacity));
+    for (qint64 b = first; b < _boundaries; ++b) {
+        sums[int(b % capacity)] = _sums[int(b % _sums.size())];
+        counts[int(b % capacity)] = _counts[int(b % _sums.size())];
+    }
+
+    _sums = sums;
+    _counts = counts;
+    _oldest = first;
+}
+
+qint64 PrefixSum::capacity() const
+{
+    return _sums.size();
+}
+
+void PrefixSum::closeBucket()
+{
+    int i = int(_boundaries % _sums.size());
+    _sums[i] = _sum;
+    _counts[i] = _count;
+    _boundaries++;
+}
+
+void PrefixSum::append(const std::complex<qreal> *x, int n)
+{
+    int i = 0;
+    while (i < n) {
+        // values up to the next boundary
+        qint64 left = _origin + qint64(_boundaries) * _bucket - _end;
+        int m = int(qMin(qint64(n - i), left));
+
+        for (int j = i; j < i + m; ++j) {
+            if (!std::isnan(x[j].real()) && !std::isnan(x[j].imag())) {
+                _sum += x[j];
+                _count++;
+            }
+        }
+
+        i += m;
+        _end += m;
+        if (_end == _origin + qint64(_boundaries) * _bucket)
+            closeBucket();
+    }
+}
+
+void PrefixSum::skip(qint64 n)
+{
+    while (n > 0) {
+        qint64 left = _origin + qint64(_boundaries) * _bucket - _end;
+        qint64 m = qMin(n, left);
+        n -= m;
+        _end += m;
+        if (_end == _origin + qint64(_boundaries) * _bucket)
+            closeBucket();
+    }
+}
+
+int PrefixSum::bucket() const
+{
+    return _bucket;
+}
+
+qint64 PrefixSum::begin() const
+{
+    return _origin + qMax(_oldest, _boundaries - _sums.size()) * _bucket;
+}
+
+qint64 PrefixSum::end() const
+{
+    return _end;
+}
+
+bool PrefixSum::at(qint64 sample, std::complex<qreal> *sum, qint64 *count) const
+{
+    if (sample == _end) {
+        *sum = _sum;
+        *count = _count;
+        return true;
+    }
+
+    if (sample < begin() || sample > _end)
+        return false;
+
+    qint64 b = (sample - _origin) / _bucket;
+    int i = int(b % _sums.size());
+    *sum = _sums[i];
+    *count = _counts[i];
+    return true;
+}
+
+bool PrefixSum::sum(qint64 from, qint64 to, std::complex<qreal> *sum, qint64 *count) const
+{
+    std::complex<qreal> s0, s1;
+    qint64 c0, c1;
+    if (from > to || !at(from, &s0, &c0) || !at(to, &s1, &c1))
+        return false;
+
+    *sum = s1 - s0;
+    *count = c1 - c0;
+    return true;
+}
+
+bool PrefixSum::mean(qint64 to, qint64 length, std::complex<qreal> *mean, qint64 *count) const
+{
+    std::complex<qreal> s;
+    qint64 c;
+    if (!sum(to - length, to, &s, &c) || c == 0)
+        return false;
+
+    *mean = s / qreal(c);
+    if (count)
+        *count = c;
+    return true;
+}
@@ -0,0 +1,80 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef PREFIXSUM_HPP
+#define PREFIXSUM_HPP
+
+#include <QVector>
+#include <complex>
+
+/* Cumulative sum of the mixed signal (left * sin/cos)
+ *
+ * The running sum and the number of valid (not NAN) values are saved at every
+ * bucket boundary, in a ring that keeps the last capacity buckets. The sum over any window
+ * [from, to) of the history is the difference of two saved values : O(1) for any length.
+ * The limits are rounded down to a bucket boundary, except to == end() which is exact.
+ *
+ * The sums are not rebased : the mixed values rotate with the reference so their sum
+ * grows slowly (mean signal * samples) and stays far from the precision limit of a double
+ * even after days of acquisition.
+ */
+
+class PrefixSum
+{
+public:
+    PrefixSum();
+
+    // forget everything, the next value appended is sample firstSample
+    void reset(qint64 firstSample, int bucket, qint64 capacity);
+    // resize the ring in place, the most recent boundaries are kept
+    void setCapacity(qint64 capacity);
+    qint64 capacity() const; // in buckets
+
+    void append(const std::complex<qreal> *x, int n); // NAN values are counted as missing
+    void skip(qint64 n); // n samples without value (lost samples)
+
+    int bucket() const;
+    qint64 begin() const; // first sample that can be used as a limit
+    qint64 end() const; // next sample
+
+    bool sum(qint64 from, qint64 to, std::complex<qreal> *sum, qint64 *count) const;
+    // mean of the valid values in [to - length, to)
+    bool mean(qint64 to, qint64 length, std::complex<qreal> *mean, qint64 *count = nullptr) const;
+
+private:
+    bool at(qint64 sample, std::complex<qreal> *sum, qint64 *count) const;
+    void closeBucket();
+
+    int _bucket; // samples per bucket
+    qint64 _origin; // sample of the boundary 0
+    qint64 _boundaries; // boundaries saved since the reset
+    qint64 _oldest; // first boundary saved in the ring (the older ones are lost after a resize)
+    QVector<std::complex<qreal>> _sums; // ring, boundary b at b % capacity
+    QVector<qint64> _counts;
+
+    qint64 _end;
+    std::complex<qreal> _sum; // up to _end
+    qint64 _count;
+};
+
+#endif // PREFIXSUM_HPP
@@ -0,0 +1,240 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "recorder.hh"
+#include "spscring.hh"
+#include "wavfile.hh"
+#include "lossless.hh"
+#include <QDebug>
+
+// the writer waits for at least this amount of data (multiple of 4 kB)
+static const qint64 chunkSize = 1 << 20;
+
+Recorder::Recorder(QObject *parent) :
+    QThread(parent)
+{
+    _ring = nullptr;
+    _lossless = nullptr;
+    _stop = false;
+    _written = 0;
+    _dropped = 0;
+    _writeError = false;
+    _pendingSilence = 0;
+}
+
+Recorder::~Recorder()
+{
+    if (isOpen())
+        close();
+}
+
+bool Recorder::open(const QString &path, const QAudioFormat &format, qreal queueSeconds)
+{
+    if (isOpen()) {
+        qDebug() << __FUNCTION__ << ": recorder is already open";
+        return false;
+    }
+
+    _format = format;
+    _silence.resize(64 * 1024 - (64 * 1024) % format.bytesPerFrame());
+    fillSilence(_silence.data(), _silence.size(), _format);
+
+    if (path.endsWith(".lkf", Qt::CaseInsensitive)) {
+        _lossless = new LosslessWriter;
+        if (!_lossless->open(path, wavFormat(_format))) {
+            delete _lossless;
+            _lossless = nullptr;
+            return false;
+        }
+    } else {
+        _file.setFileName(path);
+        if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qDebug() << __FUNCTION__ << ": cannot open" << path;
+            return false;
+        }
+
+        if (!writeWavHeader(&_file, wavFormat(_format), 0)) {
+            _file.close();
+            return false;
+        }
+    }
+
+    _ring = new SpscRing(qMax(4 * chunkSize, qint64(queueSeconds * format.bytesForDuration(1000000))));
+    _stop = false;
+    _written = 0;
+    _dropped = 0;
+    _writeError = false;
+    _pendingSilence = 0;
+
+    start(QThread::LowPriority);
+    return true;
+}
+
+void Recorder::close()
+{
+    if (!isOpen())
+        return;
+
+    _stop = true;
+    _wake.wakeOne();
+    wait();
+
+    // the samples dropped last, the queue is empty now
+    if (_pendingSilence > 0) {
+        QByteArray silence(_pendingSilence, 0);
+        fillSilence(silence.data(), silence.size(), _format);
+        convertToWav(silence.data(), silence.size(), _format);
+        if (_lossless) {
+            _lossless->write(silence.constData(), silence.size());
+        } else if (_file.write(silence) != silence.size()) {
+            qDebug() << __FUNCTION__ << ": write error" << _file.errorString();
+            _writeError = true;
+        }
+        _written.fetch_add(silence.size(), std::memory_order_relaxed);
+        _pendingSilence = 0;
+    }
+
+    if (_lossless) {
+        _lossless->close(); // last block and index
+        if (_lossless->hasError())
+            _writeError = true;
+        delete _lossless;
+        _lossless = nullptr;
+    } else {
+        // the data is complete, rewrite the header with the final size
+        _file.seek(0);
+        if (!writeWavHeader(&_file, wavFormat(_format), _written) || !_file.flush())
+            _writeError = true;
+        _file.close();
+    }
+
+    delete _ring;
+    _ring = nullptr;
+}
+
+bool Recorder::isOpen() const
+{
+    return _file.isOpen() || _lossless != nullptr;
+}
+
+/* A block that does not fit is dropped and remembered as silence,
+ * the following blocks wait behind it until the silence is in the queue
+ */
+void Recorder::push(const QByteArray &data)
+{
+    if (!flushSilence() || !_ring->write(data.constData(), data.size())) {
+        _dropped.fetch_add(data.size(), std::memory_order_relaxed);
+        _pendingSilence += data.size();
+    }
+
+    if (_ring->size() >= chunkSize)
+        _wake.wakeOne();
+}
+
+void Recorder::pushSilence(qint64 frames)
+{
+    _pendingSilence += frames * _format.bytesPerFrame();
+    flushSilence();
+
+    if (_ring->size() >= chunkSize)
+        _wake.wakeOne();
+}
+
+// writes as much of the pending silence as the queue can take, true when all of it is written
+bool Recorder::flushSilence()
+{
+    const qint64 frame = _format.bytesPerFrame();
+
+    while (_pendingSilence > 0) {
+        qint64 n = qMin(_pendingSilence, qMin(qint64(_silence.size()), _ring->space()));
+        n -= n % frame;
+        if (n <= 0 || !_ring->write(_silence.constData(), n))
+            return false;
+        _pendingSilence -= n;
+    }
+    return true;
+}
+
+qint64 Recorder::writtenBytes() const
+{
+    return _written.load(std::memory_order_relaxed);
+}
+
+qint64 Recorder::droppedBytes() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+qint64 Recorder::queuedBytes() const
+{
+    return _ring ? _ring->size() : 0;
+}
+
+bool Recorder::hasWriteError() const
+{
+    return _writeError.load(std::memory_order_relaxed);
+}
+
+void Recorder::run()
+{
+    QByteArray buffer(chunkSize, 0);
+    // frame sizes (2, 4 or 8 bytes) divide 4 kB : the chunks hold complete samples
+    const qint64 align = 4096;
+
+    forever {
+        bool stop = _stop;
+        qint64 available = _ring->size();
+
+        if (available < chunkSize && !stop) {
+            _mutex.lock();
+            _wake.wait(&_mutex, 100);
+            _mutex.unlock();
+            available = _ring->size();
+        }
+
+        // large aligned writes while running, the remaining bytes at the end
+        qint64 len = qMin(available, chunkSize);
+        if (!stop)
+            len -= len % align;
+
+        if (len > 0) {
+            _ring->read(buffer.data(), len);
+            convertToWav(buffer.data(), len, _format);
+            if (_lossless) {
+                _lossless->write(buffer.constData(), len);
+                if (_lossless->hasError())
+                    _writeError.store(true, std::memory_order_relaxed);
+            } else if (_file.write(buffer.constData(), len) != len) {
+                if (!_writeError)
+                    qDebug() << __FUNCTION__ << ": write error" << _file.errorString();
+                _writeError.store(true, std::memory_order_relaxed);
+            }
+            _written.fetch_add(len, std::memory_order_relaxed);
+        } else if (stop) {
+            break;
+        }
+    }
+
+    if (!_lossless)
+        _file.flush();
+}
@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <QThread>
+#include <QFile>
+#include <QAudioFormat>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+class SpscRing;
+class LosslessWriter;
+
+/* Records the raw stereo stream into a WAV (RF64 above 4 GB) file
+ * or, if the file name ends with .lkf, into a losslessly compressed file (see lossless.hh)
+ *
+ * push() is called by the engine and never waits on the disk :
+ * the samples go through a lock-free queue and are written by the thread of the recorder
+ * in large chunks aligned on 4 kB. If the disk is too slow the queue overflows
+ * and the samples are dropped (see droppedBytes) instead of slowing down the engine :
+ * they are replaced by silence as soon as there is room, so the file keeps the time base.
+ * The compression also runs on the thread of the recorder.
+ */
+
+class Recorder : public QThread
+{
+public:
+    explicit Recorder(QObject *parent = 0);
+    ~Recorder();
+
+    bool open(const QString &path, const QAudioFormat &format, qreal queueSeconds = 8.0);
+    void close(); // flush the queue, finalize the header and wait for the thread
+    bool isOpen() const;
+
+    // engine side, never blocks
+    void push(const QByteArray &data);
+    void pushSilence(qint64 frames); // keep the file aligned with the time base when samples are lost
+
+    qint64 writtenBytes() const;
+    qint64 droppedBytes() const;
+    qint64 queuedBytes() const;
+    bool hasWriteError() const; // the disk refused a write, the file is incomplete
+
+protected:
+    void run() override;
+
+private:
+    bool flushSilence();
+
+    QFile _file; // wav
+    LosslessWriter *_lossless; // lkf, null for wav
+    QAudioFormat _format;
+    QByteArray _silence; // silent frames in _format, written in place of the lost samples
+    SpscRing *_ring;
+    std::atomic<bool> _stop;
+    std::atomic<qint64> _written;
+    std::atomic<qint64> _dropped;
+    std::atomic<bool> _writeError;
+    qint64 _pendingSilence; // [bytes] dropped, still to be replaced by silence (engine side)
+
+    // only used to wake up the writer earlier than its timeout
+    QMutex _mutex;
+    QWaitCondition _wake;
+};
+
+#endif // RECORDER_HPP
@@ -0,0 +1,108 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "recording.hh"
+#include "wavfile.hh"
+#include <QDebug>
+
+RecordingReader::RecordingReader()
+{
+    _isLossless = false;
+    _dataOffset = 0;
+    _frames = 0;
+}
+
+bool RecordingReader::open(const QString &path)
+{
+    close();
+
+    if (path.endsWith(".lkf", Qt::CaseInsensitive)) {
+        if (!_lossless.open(path))
+            return false;
+        _isLossless = true;
+        _format = _lossless.format();
+        _frames = _lossless.frames();
+        return true;
+    }
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        qDebug() << __FUNCTION__ << ": cannot open" << path;
+        return false;
+    }
+
+    qint64 dataBytes;
+    if (!readWavHeader(&_file, &_format, &dataBytes)) {
+        _file.close();
+        return false;
+    }
+
+    _dataOffset = _file.pos();
+    // a recording that was not closed has a data size of 0
+    if (dataBytes == 0 || _dataOffset + dataBytes > _file.size())
+        dataBytes = _file.size() - _dataOffset;
+    _frames = dataBytes / _format.bytesPerFrame();
+    return true;
+}
+
+void RecordingReader::close()
+{
+    _lossless.close();
+    _isLossless = false;
+    _file.close();
+    _frames = 0;
+}
+
+const QAudioFormat &RecordingReader::format() const
+{
+    return _format;
+}
+
+qint64 RecordingReader::frames() const
+{
+    return _frames;
+}
+
+qint64 RecordingReader::position() const
+{
+    if (_isLossless)
+        return _lossless.position();
+    return (_file.pos() - _dataOffset) / _format.bytesPerFrame();
+}
+
+bool RecordingReader::seek(qint64 frame)
+{
+    if (frame < 0 || frame > _frames)
+        return false;
+    if (_isLossless)
+        return _lossless.seek(frame);
+    return _file.seek(_dataOffset + frame * _format.bytesPerFrame());
+}
+
+QByteArray RecordingReader::read(qint64 frames)
+{
+    if (_isLossless)
+        return _lossless.read(frames);
+    frames = qMin(frames, _frames - position());
+    return _file.read(frames * _format.bytesPerFrame());
+}
@@ -0,0 +1,60 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include <QAudioFormat>
+#include <QFile>
+#include "lossless.hh"
+
+/* Reads a recording made by Recorder (.wav or .lkf)
+ * the samples are returned in wavFormat()
+ */
+
+class RecordingReader
+{
+public:
+    RecordingReader();
+
+    bool open(const QString &path);
+    void close();
+
+    const QAudioFormat &format() const;
+    qint64 frames() const;
+    qint64 position() const;
+
+    bool seek(qint64 frame);
+    QByteArray read(qint64 frames);
+
+private:
+    LosslessReader _lossless;
+    bool _isLossless;
+
+    QFile _file; // wav
+    QAudioFormat _format;
+    qint64 _dataOffset;
+    qint64 _frames;
+};
+
+#endif // RECORDING_HPP
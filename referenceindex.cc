@@ -0,0 +1,185 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "referenceindex.hh"
+#include "recording.hh"
+#include "dsp.hh"
+#include <QFile>
+#include <QDebug>
+#include <cstring>
+
+static const char refMagic[8] = {'L', 'O', 'C', 'K', 'R', 'E', 'F', '\0'};
+static const quint32 refVersion = 1;
+static const quint32 refByteOrderMark = 0x01020304;
+
+struct ReferenceIndexHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    qint32 sampleRate;
+    quint32 invertLR;
+    qint64 frames; // of the recording
+    qint64 edges; // followed by edges doubles then edges - 1 floats
+};
+
+ReferenceIndex::ReferenceIndex()
+{
+    _sampleRate = 0;
+    _frames = 0;
+    _invertLR = false;
+}
+
+bool ReferenceIndex::build(RecordingReader &reader, bool invertLR, std::function<bool(qreal)> progress)
+{
+    const QAudioFormat format = reader.format();
+    const qint64 chunk = qMax(1, format.sampleRate()); // 1 second
+
+    _sampleRate = format.sampleRate();
+    _frames = reader.frames();
+    _invertLR = invertLR;
+    _edges.clear();
+    _frequencies.clear();
+
+    reader.seek(0);
+    QVector<QPair<qreal, qreal>> left_right;
+    qreal previous = 0.0; // last chopper value of the previous chunk
+    qint64 frame = 0;
+
+    while (frame < _frames) {
+        left_right.clear();
+        decodeStereo(reader.read(chunk), format, invertLR, left_right);
+        if (left_right.isEmpty())
+            break;
+
+        for (int i = 0; i < left_right.size(); ++i) {
+            const qreal current = left_right[i].second;
+            if (frame + i > 0 && previous < 0.0 && current >= 0.0) {
+                // rising edge between frame + i - 1 and frame + i
+                _edges << double(frame + i - 1) + double(-previous / (current - previous));
+            }
+            previous = current;
+        }
+        frame += left_right.size();
+
+        if (progress && !progress(qreal(frame) / qreal(_frames)))
+            return false;
+    }
+
+    _frequencies.reserve(qMax(0, _edges.size() - 1));
+    for (int k = 0; k + 1 < _edges.size(); ++k)
+        _frequencies << float(_sampleRate / (_edges[k + 1] - _edges[k]));
+
+    return true;
+}
+
+bool ReferenceIndex::save(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << __FUNCTION__ << ": cannot write" << path;
+        return false;
+    }
+
+    ReferenceIndexHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, refMagic, sizeof refMagic);
+    h.version = refVersion;
+    h.byteOrderMark = refByteOrderMark;
+    h.sampleRate = _sampleRate;
+    h.invertLR = _invertLR;
+    h.frames = _frames;
+    h.edges = _edges.size();
+
+    file.write(reinterpret_cast<const char *>(&h), sizeof h);
+    file.write(reinterpret_cast<const char *>(_edges.constData()), _edges.size() * sizeof(double));
+    file.write(reinterpret_cast<const char *>(_frequencies.constData()), _frequencies.size() * sizeof(float));
+    return file.error() == QFile::NoError;
+}
+
+bool ReferenceIndex::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    ReferenceIndexHeader h;
+    if (file.read(reinterpret_cast<char *>(&h), sizeof h) != sizeof h
+            || memcmp(h.magic, refMagic, sizeof refMagic) != 0
+            || h.version != refVersion || h.byteOrderMark != refByteOrderMark || h.edges < 0) {
+        qDebug() << __FUNCTION__ << ": invalid reference index" << path;
+        return false;
+    }
+
+    const qint64 periods = qMax(qint64(0), h.edges - 1);
+    if (file.size() != qint64(sizeof h) + h.edges * qint64(sizeof(double)) + periods * qint64(sizeof(float))) {
+        qDebug() << __FUNCTION__ << ": truncated reference index" << path;
+        return false;
+    }
+
+    _edges.resize(h.edges);
+    _frequencies.resize(periods);
+    file.read(reinterpret_cast<char *>(_edges.data()), h.edges * sizeof(double));
+    file.read(reinterpret_cast<char *>(_frequencies.data()), periods * sizeof(float));
+
+    _sampleRate = h.sampleRate;
+    _frames = h.frames;
+    _invertLR = h.invertLR != 0;
+    return true;
+}
+
+QString ReferenceIndex::sidecarPath(const QString &recordingPath)
+{
+    return recordingPath + ".lkref";
+}
+
+bool ReferenceIndex::matches(int sampleRate, qint64 frames, bool invertLR) const
+{
+    return _sampleRate == sampleRate && _frames == frames && _invertLR == invertLR;
+}
+
+int ReferenceIndex::sampleRate() const
+{
+    return _sampleRate;
+}
+
+qint64 ReferenceIndex::periods() const
+{
+    return _frequencies.size();
+}
+
+const QVector<double> &ReferenceIndex::edges() const
+{
+    return _edges;
+}
+
+const QVector<float> &ReferenceIndex::frequencies() const
+{
+    return _frequencies;
+}
+
+qreal ReferenceIndex::meanFrequency() const
+{
+    if (_edges.size() < 2)
+        return 0.0;
+    return qreal(_sampleRate) * qreal(_edges.size() - 1) / (_edges.last() - _edges.first());
+}
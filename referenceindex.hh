@@ -0,0 +1,71 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef REFERENCEINDEX_HPP
+#define REFERENCEINDEX_HPP
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+class RecordingReader;
+
+/* Rising edges of the chopper over a whole recording
+ *
+ * The edges are interpolated between the two samples around the zero crossing
+ * and numbered in frames from the start of the recording. Period k goes from edge k
+ * to edge k + 1, its frequency is kept to avoid a division when plotting or filtering.
+ * It is saved next to the recording (sidecar file) so that a new analysis
+ * with other parameters does not search the edges again.
+ */
+
+class ReferenceIndex
+{
+public:
+    ReferenceIndex();
+
+    // progress(fraction) returns false to cancel
+    bool build(RecordingReader &reader, bool invertLR, std::function<bool(qreal)> progress = nullptr);
+
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+    static QString sidecarPath(const QString &recordingPath);
+
+    // the recording it was built from
+    bool matches(int sampleRate, qint64 frames, bool invertLR) const;
+
+    int sampleRate() const;
+    qint64 periods() const;
+    const QVector<double> &edges() const; // [frame], periods() + 1 values
+    const QVector<float> &frequencies() const; // [Hz], one per period
+    qreal meanFrequency() const;
+
+private:
+    int _sampleRate;
+    qint64 _frames;
+    bool _invertLR;
+    QVector<double> _edges;
+    QVector<float> _frequencies;
+};
+
+#endif // REFERENCEINDEX_HPP
@@ -0,0 +1,107 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "replay.hh"
+#include "lockin.hh"
+#include "dsp.hh"
+#include <QDebug>
+#include <cmath>
+
+Replay::Replay()
+{
+    _invertLR = false;
+}
+
+bool Replay::open(const QString &path, bool invertLR, std::function<bool(qreal)> progress)
+{
+    if (!_reader.open(path))
+        return false;
+
+    _invertLR = invertLR;
+    const QString sidecar = ReferenceIndex::sidecarPath(path);
+
+    if (_index.load(sidecar) && _index.matches(_reader.format().sampleRate(), _reader.frames(), invertLR))
+        return true;
+
+    if (!_index.build(_reader, invertLR, progress))
+        return false;
+
+    if (!_index.save(sidecar))
+        qDebug() << __FUNCTION__ << ": cannot save the reference index" << sidecar;
+
+    return true;
+}
+
+const QAudioFormat &Replay::format() const
+{
+    return _reader.format();
+}
+
+const ReferenceIndex &Replay::index() const
+{
+    return _index;
+}
+
+bool Replay::run(Lockin *lockin, qreal outputPeriod, qint64 firstPeriod, qint64 periods,
+                 std::function<bool(qreal)> progress)
+{
+    const QVector<double> &edges = _index.edges();
+    if (firstPeriod < 0 || firstPeriod >= _index.periods()) {
+        qDebug() << __FUNCTION__ << ": no period" << firstPeriod;
+        return false;
+    }
+
+    qint64 lastEdge = periods < 0 ? edges.size() - 1 : qMin(qint64(edges.size() - 1), firstPeriod + periods);
+    const qint64 first = qint64(std::ceil(edges[firstPeriod]));
+    const qint64 last = qMin(_reader.frames(), qint64(std::ceil(edges[lastEdge])));
+    const qint64 block = qMax(qint64(1), qint64(outputPeriod * _reader.format().sampleRate()));
+
+    lockin->setInvertLR(_invertLR);
+    if (!lockin->startOffline(_reader.format(), first))
+        return false;
+
+    _reader.seek(first);
+    QVector<std::complex<qreal>> reference;
+    bool complete = true;
+
+    for (qint64 frame = first; frame < last; frame += block) {
+        QByteArray data = _reader.read(qMin(block, last - frame));
+        const int frames = data.size() / _reader.format().bytesPerFrame();
+        if (frames == 0) {
+            qDebug() << __FUNCTION__ << ": cannot read frame" << frame;
+            complete = false;
+            break;
+        }
+
+        referenceFromEdges(edges, frame, frames, reference);
+        lockin->feed(data, reference);
+
+        if (progress && !progress(qreal(frame + frames - first) / qreal(last - first))) {
+            complete = false;
+            break;
+        }
+    }
+
+    lockin->stop();
+    return complete;
+}
@@ -0,0 +1,66 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "recording.hh"
+#include "referenceindex.hh"
+
+class Lockin;
+
+/* Offline analysis of a recording
+ *
+ * open() loads the reference index saved next to the recording,
+ * or builds and saves it when it is missing or does not match.
+ * run() feeds a Lockin with the recording and the sin/cos computed from the index,
+ * so that the zero crossing search is not redone for each new set of parameters.
+ */
+
+class Replay
+{
+public:
+    Replay();
+
+    // progress(fraction) returns false to cancel
+    bool open(const QString &path, bool invertLR = false, std::function<bool(qreal)> progress = nullptr);
+
+    const QAudioFormat &format() const;
+    const ReferenceIndex &index() const;
+
+    /* The lockin is started offline, fed by blocks of outputPeriod and stopped.
+     * The demodulation starts at the rising edge of firstPeriod
+     * and runs over periods periods (-1 : up to the end)
+     * false if it did not run to the end : no such period, truncated file or canceled by progress
+     * (the outputs computed before the cancel are emitted)
+     */
+    bool run(Lockin *lockin, qreal outputPeriod, qint64 firstPeriod = 0, qint64 periods = -1,
+             std::function<bool(qreal)> progress = nullptr);
+
+private:
+    RecordingReader _reader;
+    ReferenceIndex _index;
+    bool _invertLR;
+};
+
+#endif // REPLAY_HPP
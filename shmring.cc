@@ -0,0 +1,316 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "shmring.hh"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char shmMagic[8] = {'L', 'O', 'C', 'K', 'S', 'H', 'M', '\0'};
+static const uint32_t shmVersion = 1;
+static const uint32_t shmByteOrderMark = 0x01020304;
+
+// session of the segment currently under the name, false if there is none
+static bool currentSession(const std::string &name, uint64_t *session)
+{
+    struct stat st;
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    bool found = false;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(ShmRingHeader)) {
+        void *map = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            *session = static_cast<const ShmRingHeader *>(map)->session;
+            found = true;
+            munmap(map, sizeof(ShmRingHeader));
+        }
+    }
+    ::close(fd);
+    return found;
+}
+
+ShmRingWriter::ShmRingWriter()
+{
+    _map = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _slots = nullptr;
+    _head = 0;
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    close();
+}
+
+bool ShmRingWriter::open(const std::string &name, uint64_t capacity)
+{
+    close();
+
+    uint64_t c = 1;
+    while (c < capacity)
+        c *= 2;
+    _size = sizeof(ShmRingHeader) + c * sizeof(ShmRingSlot);
+
+    // a new segment : readers of a previous one see it as stale
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot create %s: %s\n", __FUNCTION__, name.c_str(), strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, off_t(_size)) != 0) {
+        fprintf(stderr, "%s: cannot size %s: %s\n", __FUNCTION__, name.c_str(), strerror(errno));
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    _map = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_map == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map %s: %s\n", __FUNCTION__, name.c_str(), strerror(errno));
+        _map = nullptr;
+        shm_unlink(name.c_str());
+        return false;
+    }
+    _name = name;
+
+    // the segment is zeroed by ftruncate, the atomics are constructed in place
+    _header = new (_map) ShmRingHeader;
+    _slots = reinterpret_cast<ShmRingSlot *>(static_cast<char *>(_map) + sizeof(ShmRingHeader));
+    for (uint64_t i = 0; i < c; ++i) {
+        new (&_slots[i]) ShmRingSlot;
+        _slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+
+    memcpy(_header->magic, shmMagic, sizeof shmMagic);
+    _header->version = shmVersion;
+    _header->byteOrderMark = shmByteOrderMark;
+    _header->headerSize = sizeof(ShmRingHeader);
+    _header->slotSize = sizeof(ShmRingSlot);
+    _header->capacity = c;
+    _header->session = uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()) ^ uint64_t(getpid());
+    _head = 0;
+    _header->head.store(0, std::memory_order_release);
+
+    return true;
+}
+
+void ShmRingWriter::close()
+{
+    if (_map == nullptr)
+        return;
+
+    // another writer may have recreated the segment since open() : its name is left alone
+    uint64_t session;
+    if (currentSession(_name, &session) && session == _header->session)
+        shm_unlink(_name.c_str());
+    munmap(_map, _size);
+    _map = nullptr;
+    _header = nullptr;
+    _slots = nullptr;
+}
+
+bool ShmRingWriter::isOpen() const
+{
+    return _map != nullptr;
+}
+
+void ShmRingWriter::write(const ShmRingRecord &record)
+{
+    const uint64_t n = _head;
+    ShmRingSlot &slot = _slots[n & (_header->capacity - 1)];
+
+    uint64_t words[sizeof(ShmRingRecord) / 8];
+    memcpy(words, &record, sizeof record);
+    words[0] = n; // sequence
+
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < sizeof(ShmRingRecord) / 8; ++i)
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+
+    _head = n + 1;
+    _header->head.store(_head, std::memory_order_release);
+}
+
+uint64_t ShmRingWriter::written() const
+{
+    return _head;
+}
+
+ShmRingReader::ShmRingReader()
+{
+    _map = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _slots = nullptr;
+    _mask = 0;
+    _session = 0;
+    _cursor = 0;
+    _lost = 0;
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    close();
+}
+
+bool ShmRingReader::open(const std::string &name)
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open %s: %s\n", __FUNCTION__, name.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ShmRingHeader)) {
+        fprintf(stderr, "%s: %s is too small\n", __FUNCTION__, name.c_str());
+        ::close(fd);
+        return false;
+    }
+    _size = size_t(st.st_size);
+    _map = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (_map == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map %s: %s\n", __FUNCTION__, name.c_str(), strerror(errno));
+        _map = nullptr;
+        return false;
+    }
+
+    _header = static_cast<const ShmRingHeader *>(_map);
+    if (memcmp(_header->magic, shmMagic, sizeof shmMagic) != 0 || _header->version != shmVersion
+            || _header->byteOrderMark != shmByteOrderMark || _header->slotSize != sizeof(ShmRingSlot)
+            || _header->headerSize < sizeof(ShmRingHeader) || _header->headerSize > _size
+            || _header->capacity == 0 || (_header->capacity & (_header->capacity - 1)) != 0
+            || _header->capacity > (_size - _header->headerSize) / _header->slotSize) {
+        fprintf(stderr, "%s: %s is not a lockin ring\n", __FUNCTION__, name.c_str());
+        close();
+        return false;
+    }
+
+    _name = name;
+    _slots = reinterpret_cast<const ShmRingSlot *>(static_cast<const char *>(_map) + _header->headerSize);
+    _mask = _header->capacity - 1;
+    _session = _header->session;
+    _cursor = head();
+    _lost = 0;
+    return true;
+}
+
+void ShmRingReader::close()
+{
+    if (_map == nullptr)
+        return;
+
+    munmap(_map, _size);
+    _map = nullptr;
+    _header = nullptr;
+    _slots = nullptr;
+}
+
+bool ShmRingReader::isOpen() const
+{
+    return _map != nullptr;
+}
+
+bool ShmRingReader::isStale() const
+{
+    uint64_t session;
+    return !currentSession(_name, &session) || session != _session;
+}
+
+uint64_t ShmRingReader::head() const
+{
+    return _header->head.load(std::memory_order_acquire);
+}
+
+bool ShmRingReader::latest(ShmRingRecord *record) const
+{
+    const uint64_t h = head();
+    return h > 0 && read(h - 1, record);
+}
+
+bool ShmRingReader::read(uint64_t n, ShmRingRecord *record) const
+{
+    const ShmRingSlot &slot = _slots[n & _mask];
+
+    const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+    if (s1 != 2 * n + 2)
+        return false;
+
+    uint64_t words[sizeof(ShmRingRecord) / 8];
+    for (size_t i = 0; i < sizeof(ShmRingRecord) / 8; ++i)
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // overwritten while copying
+    if (slot.seq.load(std::memory_order_relaxed) != s1)
+        return false;
+
+    memcpy(record, words, sizeof *record);
+    return true;
+}
+
+bool ShmRingReader::next(ShmRingRecord *record)
+{
+    for (;;) {
+        const uint64_t h = head();
+        if (_cursor >= h)
+            return false;
+
+        // keep one slot of margin : the writer may be into the oldest one
+        const uint64_t oldest = h > _mask ? h - _mask : 0;
+        if (_cursor < oldest) {
+            _lost += oldest - _cursor;
+            _cursor = oldest;
+        }
+
+        if (read(_cursor, record)) {
+            _cursor++;
+            return true;
+        }
+        // overwritten between head() and read(), move up to the new oldest
+    }
+}
+
+uint64_t ShmRingReader::cursor() const
+{
+    return _cursor;
+}
+
+uint64_t ShmRingReader::lost() const
+{
+    return _lost;
+}
@@ -0,0 +1,144 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef SHMRING_HPP
+#define SHMRING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Lockin outputs in a POSIX shared memory ring, one writer process and any number of readers
+ *
+ * [ShmRingHeader][ShmRingSlot][ShmRingSlot]... (capacity slots, a power of two)
+ *
+ * The record n goes into the slot n % capacity, guarded by a sequence lock :
+ * the writer sets the sequence of the slot to 2n+1, writes the record, then sets it to 2n+2,
+ * and publishes head = n+1. A reader copies the slot and checks that the sequence did not move,
+ * so it never blocks the writer and it detects the records overwritten while it was late.
+ * After the mapping nothing goes through the kernel : no system call per record.
+ *
+ * These two files depend only on POSIX and C++11, so that clients can build them without Qt
+ * (link with -lrt on older glibc).
+ */
+
+struct ShmRingRecord {
+    uint64_t sequence; // n, counted by the writer from 0
+    int64_t sampleIndex; // see LockinMeasure
+    double time; // [s]
+    double x;
+    double y;
+    int64_t systemTimeNs; // 0 if disabled
+    uint32_t flags; // LockinMeasure::Flag
+    uint32_t channel;
+};
+
+static_assert(sizeof(ShmRingRecord) == 56, "ShmRingRecord layout");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the atomics must be lock-free to be shared between processes");
+
+struct ShmRingSlot {
+    std::atomic<uint64_t> seq; // 2n+1 while writing record n, 2n+2 when it is complete
+    std::atomic<uint64_t> words[sizeof(ShmRingRecord) / 8]; // the record, word by word
+};
+
+static_assert(sizeof(ShmRingSlot) == 64, "one slot per cache line");
+
+struct ShmRingHeader {
+    char magic[8]; // "LOCKSHM\0"
+    uint32_t version;
+    uint32_t byteOrderMark; // 0x01020304 written natively
+    uint32_t headerSize;
+    uint32_t slotSize;
+    uint64_t capacity; // slots
+    uint64_t session; // changes when the writer recreates the segment
+    char reserved[24];
+    alignas(64) std::atomic<uint64_t> head; // records written
+    char padding[56];
+};
+
+static_assert(sizeof(ShmRingHeader) == 128, "ShmRingHeader layout");
+
+class ShmRingWriter
+{
+public:
+    ShmRingWriter();
+    ~ShmRingWriter();
+
+    // name like "/lockin", capacity is rounded up to a power of two
+    bool open(const std::string &name, uint64_t capacity = 4096);
+    void close(); // unlinks the name if it is still this segment, the mapped readers keep the last records
+    bool isOpen() const;
+
+    void write(const ShmRingRecord &record); // the sequence is set here, never blocks
+    uint64_t written() const;
+
+private:
+    std::string _name;
+    void *_map;
+    size_t _size;
+    ShmRingHeader *_header;
+    ShmRingSlot *_slots;
+    uint64_t _head;
+};
+
+class ShmRingReader
+{
+public:
+    ShmRingReader();
+    ~ShmRingReader();
+
+    bool open(const std::string &name);
+    void close();
+    bool isOpen() const;
+    // true if the writer did recreate the segment since open(), then reopen
+    bool isStale() const;
+
+    uint64_t head() const; // records written so far
+    // the last complete record, false if there is none yet
+    bool latest(ShmRingRecord *record) const;
+    // record n, false if it is not written yet or already overwritten
+    bool read(uint64_t n, ShmRingRecord *record) const;
+
+    /* Records in order from the cursor (starts at the head when opening)
+     * false when there is no new record. The records lost because the reader
+     * was more than capacity behind are skipped and counted into lost()
+     */
+    bool next(ShmRingRecord *record);
+    uint64_t cursor() const;
+    uint64_t lost() const;
+
+private:
+    std::string _name;
+    void *_map;
+    size_t _size;
+    const ShmRingHeader *_header;
+    const ShmRingSlot *_slots;
+    uint64_t _mask;
+    uint64_t _session;
+    uint64_t _cursor;
+    uint64_t _lost;
+};
+
+#endif // SHMRING_HPP
@@ -0,0 +1,134 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#include "spectrum.hh"
+#include <QElapsedTimer>
+#include <cmath>
+
+SpectrumAnalyzer::SpectrumAnalyzer(QObject *parent) :
+    QObject(parent),
+    _sampleRate(0),
+    _windowPower(1.0),
+    _segments(0),
+    _averages(1)
+{
+}
+
+void SpectrumAnalyzer::reset(int fftSize, int sampleRate)
+{
+    _fft.setSize(fftSize);
+    _sampleRate = sampleRate;
+
+    _window.resize(fftSize);
+    _windowPower = 0.0;
+    for (int i = 0; i < fftSize; ++i) {
+        _window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * qreal(i) / qreal(fftSize));
+        _windowPower += _window[i] * _window[i];
+    }
+
+    _in.resize(fftSize);
+    _out.resize(fftSize);
+    _psd.fill(0.0, fftSize / 2 + 1);
+    _pending.clear();
+    _segments = 0;
+}
+
+// one windowed segment into the average
+void SpectrumAnalyzer::segment(const qreal *x)
+{
+    const int n = _fft.size();
+    for (int i = 0; i < n; ++i)
+        _in[i] = x[i] * _window[i];
+    _fft.transform(_in.constData(), _out.data());
+
+    // one-sided density, the bins 0 and n/2 are not doubled
+    const qreal scale = 1.0 / (qreal(_sampleRate) * _windowPower);
+    const qreal alpha = _segments < _averages ? 1.0 / qreal(_segments + 1) : 1.0 / qreal(_averages);
+    for (int k = 0; k < _psd.size(); ++k) {
+        qreal p = std::norm(_out[k]) * scale;
+        if (k != 0 && 2 * k != n)
+            p *= 2.0;
+        _psd[k] += alpha * (p - _psd[k]);
+    }
+    _segments++;
+}
+
+void SpectrumAnalyzer::addBlock(const SpectrumBlock &block)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const int n = qMax(16, block.fftSize);
+    if (n != _fft.size() || block.sampleRate != _sampleRate || block.sampleRate <= 0)
+        reset(n, block.sampleRate);
+    if (!block.continuous)
+        _pending.clear();
+    _averages = qMax(1, block.averages);
+
+    for (int i = 0; i < block.left_right.size(); ++i)
+        _pending << block.left_right[i].first;
+
+    // overlap of one half
+    const int hop = n / 2;
+    int used = 0;
+    while (_pending.size() - used >= n) {
+        segment(_pending.constData() + used);
+        used += hop;
+    }
+    _pending.remove(0, used);
+
+    Spectrum spectrum;
+    spectrum.segments = _segments;
+
+    if (_segments > 0) {
+        // log axis from the first bin to Nyquist, one column per pixel
+        const qreal df = qreal(_sampleRate) / qreal(n);
+        const qreal lmin = std::log10(df);
+        const qreal lmax = std::log10(qreal(_sampleRate) / 2.0);
+        const int columns = qMax(1, block.columns);
+        const qreal perColumn = (lmax - lmin) / qreal(columns);
+
+        int column = -1;
+        QPointF best;
+        for (int k = 1; k < _psd.size(); ++k) {
+            const qreal l = std::log10(k * df);
+            const int c = qMin(columns - 1, int((l - lmin) / perColumn));
+            const QPointF p(l, 10.0 * std::log10(qMax(_psd[k], 1e-30)));
+
+            if (c != column) {
+                if (column >= 0)
+                    spectrum.points << best;
+                column = c;
+                best = p;
+            } else if (p.y() > best.y()) {
+                best = p;
+            }
+        }
+        if (column >= 0)
+            spectrum.points << best;
+    }
+
+    spectrum.computeNs = timer.nsecsElapsed();
+    emit ready(spectrum);
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+#ifndef SPECTRUM_HPP
+#define SPECTRUM_HPP
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QPair>
+#include <QPointF>
+#include "fft.hh"
+
+// decoded block of the lockin for the spectrum
+struct SpectrumBlock {
+    QVector<QPair<qreal, qreal>> left_right; // shared with Lockin::raw_signals(), no copy
+    int sampleRate;
+    int fftSize;
+    int averages; // exponential average over about this number of segments
+    int columns; // width of the graph in pixels
+    bool continuous; // follows the previous block, false if blocks were skipped
+};
+Q_DECLARE_METATYPE(SpectrumBlock)
+
+struct Spectrum {
+    QList<QPointF> points; // (log10(frequency / Hz), power spectral density in dB / Hz)
+    qint64 segments; // averaged since the last reset
+    qint64 computeNs; // time spent into addBlock()
+};
+Q_DECLARE_METATYPE(Spectrum)
+
+/* Welch spectrum of the left channel, lives into a worker thread
+ *
+ * Segments of fftSize samples overlapped by one half, Hann window, one-sided PSD.
+ * The bins are decimated on a log frequency axis : one point per pixel column
+ * (the bin of maximal power) where the bins are denser than the pixels.
+ */
+class SpectrumAnalyzer : public QObject {
+    Q_OBJECT
+public:
+    explicit SpectrumAnalyzer(QObject *parent = 0);
+
+public slots:
+    void addBlock(const SpectrumBlock &block);
+
+signals:
+    void ready(const Spectrum &spectrum);
+
+private:
+    void reset(int fftSize, int sampleRate);
+    void segment(const qreal *x);
+
+    Fft _fft;
+    int _sampleRate;
+    QVector<qreal> _window; // Hann
+    qreal _windowPower; // sum of window^2
+    QVector<qreal> _pending; // samples waiting for a complete segment
+    QVector<std::complex<qreal>> _in;
+    QVector<std::complex<qreal>> _out;
+    QVector<qreal> _psd; // averaged, fftSize / 2 + 1 bins
+    qint64 _segments;
+    int _averages;
+};
+
+#endif // SPECTRUM_HPP
@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+/* Lock-free ring buffer of bytes for one producer thread and one consumer thread
+ * The producer never waits : write() fails when there is not enough room
+ */
+
+class SpscRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(qint64 capacity)
+    {
+        qint64 c = 1;
+        while (c < capacity)
+            c *= 2;
+        _buffer.resize(c);
+        _mask = c - 1;
+        _head = 0;
+        _tail = 0;
+    }
+
+    qint64 capacity() const { return _mask + 1; }
+
+    // bytes ready to be read
+    qint64 size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    // producer : room left for write()
+    qint64 space() const
+    {
+        return capacity() - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+    }
+
+    // producer : write all or nothing
+    bool write(const char *data, qint64 len)
+    {
+        const qint64 head = _head.load(std::memory_order_relaxed);
+        const qint64 tail = _tail.load(std::memory_order_acquire);
+        if (capacity() - (head - tail) < len)
+            return false;
+
+        copyIn(head, data, len);
+        _head.store(head + len, std::memory_order_release);
+        return true;
+    }
+
+    // consumer : read up to len bytes
+    qint64 read(char *data, qint64 len)
+    {
+        const qint64 tail = _tail.load(std::memory_order_relaxed);
+        const qint64 head = _head.load(std::memory_order_acquire);
+        len = qMin(len, head - tail);
+
+        copyOut(tail, data, len);
+        _tail.store(tail + len, std::memory_order_release);
+        return len;
+    }
+
+private:
+    void copyIn(qint64 position, const char *data, qint64 len)
+    {
+        qint64 offset = position & _mask;
+        qint64 first = qMin(len, capacity() - offset);
+        memcpy(&_buffer[offset], data, first);
+        memcpy(&_buffer[0], data + first, len - first);
+    }
+
+    void copyOut(qint64 position, char *data, qint64 len)
+    {
+        qint64 offset = position & _mask;
+        qint64 first = qMin(len, capacity() - offset);
+        memcpy(data, &_buffer[offset], first);
+        memcpy(data + first, &_buffer[0], len - first);
+    }
+
+    std::vector<char> _buffer;
+    qint64 _mask;
+    std::atomic<qint64> _head; // total bytes written, owned by the producer
+    std::atomic<qint64> _tail; // total bytes read, owned by the consumer
+};
+
+#endif // SPSCRING_HPP
@@ -0,0 +1,127 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+
+/* The samples lost by the recorder (full queue) or before it (gaps) are written as silence :
+ * the middle of the range for unsigned formats, whatever the byte order
+ * Returns non-zero on the first failure
+ */
+
+#include "../recorder.hh"
+#include "../wavfile.hh"
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtEndian>
+
+static QTextStream err(stderr);
+
+static QAudioFormat stereo(int size, QAudioFormat::SampleType type, QAudioFormat::Endian order)
+{
+    QAudioFormat format;
+    format.setSampleRate(48000);
+    format.setChannelCount(2);
+    format.setCodec("audio/pcm");
+    format.setSampleSize(size);
+    format.setSampleType(type);
+    format.setByteOrder(order);
+    return format;
+}
+
+// frames of silence in format, built by hand to check fillSilence()
+static QByteArray midpoint(const QAudioFormat &format, int frames)
+{
+    QByteArray data;
+    for (int i = 0; i < frames * format.channelCount(); ++i) {
+        if (format.sampleSize() == 8) {
+            data.append(char(0x80));
+        } else if (format.byteOrder() == QAudioFormat::BigEndian) {
+            data.append(char(0x80));
+            data.append(char(0x00));
+        } else {
+            data.append(char(0x00));
+            data.append(char(0x80));
+        }
+    }
+    return data;
+}
+
+static bool check(const QString &name, const QAudioFormat &format, const QString &path)
+{
+    const int frames = 100;
+    const int lost = 1000;
+
+    Recorder recorder;
+    if (!recorder.open(path, format)) {
+        err << name << ": cannot open " << path << "\n";
+        return false;
+    }
+    recorder.push(midpoint(format, frames));
+    recorder.pushSilence(lost);
+    recorder.push(midpoint(format, frames));
+    recorder.close();
+
+    QFile file(path);
+    QAudioFormat wav;
+    qint64 bytes = 0;
+    if (!file.open(QIODevice::ReadOnly) || !readWavHeader(&file, &wav, &bytes)) {
+        err << name << ": cannot read " << path << "\n";
+        return false;
+    }
+    if (bytes != (2 * frames + lost) * format.bytesPerFrame()) {
+        err << name << ": " << bytes << " bytes written\n";
+        return false;
+    }
+
+    // wav : unsigned for 8 bits, signed little endian otherwise, the silence is 0x80 or 0
+    const QByteArray data = file.read(bytes);
+    const int size = format.sampleSize() / 8;
+    for (qint64 i = 0; i < data.size(); i += size) {
+        const int sample = size == 1 ? int(uchar(data[int(i)])) - 128
+                                     : qFromLittleEndian<qint16>(reinterpret_cast<const uchar *>(data.constData() + i));
+        if (sample != 0) {
+            err << name << ": sample " << i / size << " is " << sample << " instead of silence\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        err << "cannot create a temporary directory\n";
+        return 1;
+    }
+
+    bool ok = true;
+    ok &= check("unsigned 16 bits little endian", stereo(16, QAudioFormat::UnSignedInt, QAudioFormat::LittleEndian), dir.filePath("u16le.wav"));
+    ok &= check("unsigned 16 bits big endian", stereo(16, QAudioFormat::UnSignedInt, QAudioFormat::BigEndian), dir.filePath("u16be.wav"));
+    ok &= check("unsigned 8 bits", stereo(8, QAudioFormat::UnSignedInt, QAudioFormat::LittleEndian), dir.filePath("u8.wav"));
+
+    err << (ok ? "ok\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+QT += multimedia
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = test_recorder
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include($$PWD/../engine.pri)
+
+SOURCES += test_recorder.cc
@@ -0,0 +1,3 @@
+TEMPLATE = subdirs
+
+SUBDIRS += test_recorder.pro
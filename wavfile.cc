@@ -0,0 +1,161 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#include "wavfile.hh"
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+QAudioFormat wavFormat(const QAudioFormat &format)
+{
+    QAudioFormat f = format;
+    f.setByteOrder(QAudioFormat::LittleEndian);
+    if (f.sampleType() != QAudioFormat::Float)
+        f.setSampleType(f.sampleSize() == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
+    return f;
+}
+
+void convertToWav(char *data, qint64 len, const QAudioFormat &format)
+{
+    const int bytes = format.sampleSize() / 8;
+    const QAudioFormat wav = wavFormat(format);
+
+    if (format.byteOrder() == QAudioFormat::BigEndian && bytes > 1) {
+        for (qint64 i = 0; i + bytes <= len; i += bytes)
+            std::reverse(data + i, data + i + bytes);
+    }
+
+    if (format.sampleType() != wav.sampleType()) {
+        // signed <-> unsigned : flip the most significant bit (now the last byte)
+        for (qint64 i = bytes - 1; i < len; i += bytes)
+            data[i] ^= char(0x80);
+    }
+}
+
+void fillSilence(char *data, qint64 len, const QAudioFormat &format)
+{
+    memset(data, 0, len);
+    if (format.sampleType() != QAudioFormat::UnSignedInt)
+        return;
+
+    // 0x80 into the most significant byte
+    const int bytes = format.sampleSize() / 8;
+    const int msb = format.byteOrder() == QAudioFormat::BigEndian ? 0 : bytes - 1;
+    for (qint64 i = msb; i < len; i += bytes)
+        data[i] = char(0x80);
+}
+
+static void put16(char *p, quint16 x) { qToLittleEndian(x, reinterpret_cast<uchar *>(p)); }
+static void put32(char *p, quint32 x) { qToLittleEndian(x, reinterpret_cast<uchar *>(p)); }
+static void put64(char *p, quint64 x) { qToLittleEndian(x, reinterpret_cast<uchar *>(p)); }
+
+bool writeWavHeader(QIODevice *device, const QAudioFormat &format, qint64 dataBytes)
+{
+    QByteArray h(wavHeaderSize, 0);
+    char *p = h.data();
+
+    const bool rf64 = wavHeaderSize - 8 + dataBytes > qint64(0xffffffff);
+    const quint32 blockAlign = format.bytesPerFrame();
+
+    memcpy(p, rf64 ? "RF64" : "RIFF", 4);
+    put32(p + 4, rf64 ? 0xffffffff : quint32(wavHeaderSize - 8 + dataBytes));
+    memcpy(p + 8, "WAVE", 4);
+
+    // 12 : ds64 or JUNK of the same size
+    memcpy(p + 12, rf64 ? "ds64" : "JUNK", 4);
+    put32(p + 16, 28);
+    if (rf64) {
+        put64(p + 20, wavHeaderSize - 8 + dataBytes); // riff size
+        put64(p + 28, dataBytes); // data size
+        put64(p + 36, dataBytes / blockAlign); // sample count
+        put32(p + 44, 0); // table length
+    }
+
+    // 48 : fmt
+    memcpy(p + 48, "fmt ", 4);
+    put32(p + 52, 16);
+    put16(p + 56, format.sampleType() == QAudioFormat::Float ? 3 : 1);
+    put16(p + 58, format.channelCount());
+    put32(p + 60, format.sampleRate());
+    put32(p + 64, format.sampleRate() * blockAlign);
+    put16(p + 68, blockAlign);
+    put16(p + 70, format.sampleSize());
+
+    // 72 : padding up to the data
+    memcpy(p + 72, "JUNK", 4);
+    put32(p + 76, wavHeaderSize - 72 - 8 - 8);
+
+    memcpy(p + wavHeaderSize - 8, "data", 4);
+    put32(p + wavHeaderSize - 4, rf64 ? 0xffffffff : quint32(dataBytes));
+
+    return device->write(h) == wavHeaderSize;
+}
+
+bool readWavHeader(QIODevice *device, QAudioFormat *format, qint64 *dataBytes)
+{
+    QByteArray riff = device->read(12);
+    if (riff.size() != 12 || (!riff.startsWith("RIFF") && !riff.startsWith("RF64")) || riff.mid(8, 4) != "WAVE") {
+        qDebug() << __FUNCTION__ << ": not a wav file";
+        return false;
+    }
+
+    qint64 ds64DataBytes = -1;
+    bool fmt = false;
+
+    forever {
+        QByteArray chunk = device->read(8);
+        if (chunk.size() != 8) {
+            qDebug() << __FUNCTION__ << ": no data chunk";
+            return false;
+        }
+        const QByteArray id = chunk.left(4);
+        const quint32 size = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(chunk.constData() + 4));
+
+        if (id == "data") {
+            *dataBytes = (size == 0xffffffff && ds64DataBytes >= 0) ? ds64DataBytes : qint64(size);
+            return fmt;
+        }
+
+        QByteArray body = device->read(size + (size & 1));
+        const uchar *b = reinterpret_cast<const uchar *>(body.constData());
+        if (body.size() < qint64(size))
+            return false;
+
+        if (id == "ds64" && size >= 16) {
+            ds64DataBytes = qFromLittleEndian<quint64>(b + 8);
+        } else if (id == "fmt " && size >= 16) {
+            const quint16 tag = qFromLittleEndian<quint16>(b);
+            format->setCodec("audio/pcm");
+            format->setChannelCount(qFromLittleEndian<quint16>(b + 2));
+            format->setSampleRate(qFromLittleEndian<quint32>(b + 4));
+            format->setSampleSize(qFromLittleEndian<quint16>(b + 14));
+            format->setByteOrder(QAudioFormat::LittleEndian);
+            if (tag == 3)
+                format->setSampleType(QAudioFormat::Float);
+            else
+                format->setSampleType(format->sampleSize() == 8 ? QAudioFormat::UnSignedInt : QAudioFormat::SignedInt);
+            fmt = true;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/****************************************************************************
+**
+**  Copyright (C) 2015 Mario Geiger
+**  Contact: geiger.mario@gmail.com
+**
+**  This file is part of lockin2.
+**
+**  lockin2 is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU Lesser General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  lockin2 is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public License
+**  along with lockin2.  If not, see <http://www.gnu.org/licenses/>.
+**
+****************************************************************************/
+
+
+#ifndef WAVFILE_HPP
+#define WAVFILE_HPP
+
+#include <QAudioFormat>
+#include <QIODevice>
+
+/* WAV and RF64 (EBU Tech 3306) headers
+ *
+ * The header written by writeWavHeader() is always wavHeaderSize bytes long
+ * so that the samples start on a 4 kB boundary, it contains
+ * a JUNK chunk which is turned into a ds64 chunk when the data exceeds 4 GB
+ */
+
+const qint64 wavHeaderSize = 4096;
+
+// WAV samples are little endian, unsigned for 8 bits and signed otherwise
+QAudioFormat wavFormat(const QAudioFormat &format);
+// convert samples from format into wavFormat(format), in place
+void convertToWav(char *data, qint64 len, const QAudioFormat &format);
+// silent samples in format : the middle of the range for unsigned samples, zero otherwise
+void fillSilence(char *data, qint64 len, const QAudioFormat &format);
+
+// write the header at the current position (the start of the file), dataBytes can be updated later
+bool writeWavHeader(QIODevice *device, const QAudioFormat &format, qint64 dataBytes);
+
+// read a WAV or RF64 header, the device is left at the first sample
+bool readWavHeader(QIODevice *device, QAudioFormat *format, qint64 *dataBytes);
+
+#endif // WAVFILE_HPP